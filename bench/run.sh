@@ -0,0 +1,137 @@
+#!/bin/bash
+# Benchmark suite for the three simulators, checked against bench/baseline.txt.
+#
+#   bench/run.sh            run everything, report, exit 1 if any case regressed
+#   bench/run.sh --update   run everything and rewrite the baseline with the results
+#
+# Every case yields one number where lower is better: seconds for end-to-end runs, CPU cycles
+# for select_victim_frame (from the MMU_PROFILE build), ns per operation for get_next, ns per
+# input byte for each linker pass (from the LINKER_PROFILE build). A case
+# regresses when it is more than BENCH_TOLERANCE (default 0.25, i.e. 25%) above its baseline.
+# Inputs are generated with fixed seeds, so runs differ only in timing. Baselines are only
+# meaningful on the machine they were recorded on: after changing machines, run --update
+# on the old commit first.
+
+set -e
+ROOT=$(cd "$(dirname "$0")/.." && pwd)
+BASELINE=$ROOT/bench/baseline.txt
+BUILD=${BENCH_BUILD:-$(mktemp -d)}
+TOLERANCE=${BENCH_TOLERANCE:-0.25}
+REPEAT=${BENCH_REPEAT:-5}
+CXX=${CXX:-g++}
+CXXFLAGS=${CXXFLAGS:--O2 -std=c++17}
+UPDATE=0
+[ "$1" = "--update" ] && UPDATE=1
+
+mkdir -p "$BUILD"
+# mmu.cpp includes bithacks.h, which is not part of the tree; it uses nothing from it
+[ -f "$ROOT/bithacks.h" ] || : > "$BUILD/bithacks.h"
+echo "building in $BUILD"
+$CXX $CXXFLAGS -I"$BUILD" -o "$BUILD/mmu" "$ROOT/mmu.cpp"
+$CXX $CXXFLAGS -I"$BUILD" -DMMU_PROFILE -o "$BUILD/mmu_profile" "$ROOT/mmu.cpp"
+$CXX $CXXFLAGS -pthread -o "$BUILD/ioschedlab4" "$ROOT/ioschedlab4.cpp"
+$CXX $CXXFLAGS -pthread -o "$BUILD/final_linker" "$ROOT/final_linker.cpp"
+$CXX $CXXFLAGS -pthread -DLINKER_PROFILE -o "$BUILD/final_linker_profile" "$ROOT/final_linker.cpp"
+
+RESULTS=$BUILD/results.txt
+: > "$RESULTS"
+record() { printf '%s %s\n' "$1" "$2" >> "$RESULTS"; }
+
+# best wall time of REPEAT runs, in seconds
+best_time() {
+    local best=""
+    for ((r = 0; r < REPEAT; r++)); do
+        local start=$(date +%s%N)
+        "$@" > /dev/null
+        local t=$(( $(date +%s%N) - start ))
+        if [ -z "$best" ] || [ "$t" -lt "$best" ]; then best=$t; fi
+    done
+    awk -v ns="$best" 'BEGIN { printf "%.4f", ns / 1e9 }'
+}
+
+# ---- mmu: select_victim_frame cost per pager vs frame count, then InstructionReader throughput
+MMU_LOAD="n=2000000,procs=8,dist=zipf,s=0.8,ctx=0.001,seed=41"
+for a in f r c e a w; do
+    for f in 16 64 128; do
+        "$BUILD/mmu_profile" -f$f -a$a -oS -p "$BUILD/profile.json" -g "$MMU_LOAD" > /dev/null
+        cycles=$(sed -n 's/.*"select_cycles": {"count": [0-9]*, "min": [0-9]*, "max": [0-9]*, "mean": \([0-9.]*\).*/\1/p' "$BUILD/profile.json")
+        record "mmu_select_${a}_f$f" "${cycles:-0}"
+        record "mmu_run_${a}_f$f" "$(best_time "$BUILD/mmu" -f$f -a$a -oS -g "$MMU_LOAD")"
+    done
+done
+"$BUILD/mmu" -g "n=5000000,procs=8,seed=42" -E > "$BUILD/mmu_input"
+seq 0 40000 > "$BUILD/rfile"
+record mmu_parse_file "$(best_time "$BUILD/mmu" -f128 -af -oS "$BUILD/mmu_input" "$BUILD/rfile")"
+record mmu_parse_generated "$(best_time "$BUILD/mmu" -f128 -af -oS -g "n=5000000,procs=8,seed=42" "$BUILD/rfile")"
+
+# ---- ioschedlab4: get_next + add cost vs queue depth, then whole simulations
+"$BUILD/ioschedlab4" -Y256 | awk 'NR == 1 { for (i = 2; i <= 8; i++) alg[i] = $i; next }
+                                  { for (i = 2; i <= 8; i++) print "sched_getnext_" alg[i] "_d" $1, $i }' >> "$RESULTS"
+for s in N S L C F D B; do
+    record "sched_run_$s" "$(best_time "$BUILD/ioschedlab4" -s$s -g "n=200000,gap=12,arrival=bursty,dist=zipf,streams=4,seed=43")"
+done
+
+# ---- final_linker: an input cut off anywhere in a module must link what it has (or report a
+# parse error), never abort. The module ends in an E, so a cut after its opcode reaches parseE
+# with the -1 that readInt returns at end of input.
+MODULE=$'1 X 0\n1 Y\n3 R 1002 I 1234 E 1000\n'
+for ((cut = 0; cut <= ${#MODULE}; cut++)); do
+    printf '%s' "${MODULE:0:cut}" > "$BUILD/linker_cut"
+    status=0
+    "$BUILD/final_linker" "$BUILD/linker_cut" > /dev/null 2>&1 || status=$?
+    if [ $status -gt 1 ]; then echo "final_linker exits $status on a module cut after $cut bytes"; exit 1; fi
+done
+
+# ---- final_linker: Pass1 and Pass2 throughput vs input size, linked with -l. Every module
+# defines four symbols and uses the four of the module before it, so the symbol table grows with
+# the module count. Each pass keeps its best time of REPEAT runs.
+linker_input() {
+    awk -v m="$1" -v k=10000000 'BEGIN {
+        for (i = 0; i < m; i++) {
+            print "4 S" i "a 0 S" i "b 1 S" i "c 2 S" i "d 3"
+            if (i == 0) { print "0"; print "5 R " k + 2 " I 1234 A " 2 * k + 1 " R " k " I " 5 * k }
+            else { p = "S" i - 1; print "4 " p "a " p "b " p "c " p "d"; print "5 E " k " E " k + 1 " E " k + 2 " E " k + 3 " R " k + 4 }
+        }
+    }'
+}
+printf '%8s  %10s  %10s  %10s\n' modules bytes "pass1 MB/s" "pass2 MB/s"
+for m in 1000 10000 100000; do
+    linker_input $m > "$BUILD/linker_$m"
+    bytes=$(wc -c < "$BUILD/linker_$m")
+    pass1=""; pass2=""
+    for ((r = 0; r < REPEAT; r++)); do
+        read -r _ t1 _ t2 < <("$BUILD/final_linker_profile" -l "$BUILD/linker_$m" 2>&1 > /dev/null)
+        if [ -z "$pass1" ] || [ "$t1" -lt "$pass1" ]; then pass1=$t1; fi
+        if [ -z "$pass2" ] || [ "$t2" -lt "$pass2" ]; then pass2=$t2; fi
+    done
+    awk -v m=$m -v b=$bytes -v p1=$pass1 -v p2=$pass2 'BEGIN { printf "%8d  %10d  %10.1f  %10.1f\n", m, b, b * 1e3 / p1, b * 1e3 / p2 }'
+    record "linker_pass1_m$m" "$(awk -v b=$bytes -v t=$pass1 'BEGIN { printf "%.2f", t / b }')"
+    record "linker_pass2_m$m" "$(awk -v b=$bytes -v t=$pass2 'BEGIN { printf "%.2f", t / b }')"
+done
+
+# ---- report
+if [ $UPDATE -eq 1 ]; then
+    {
+        echo "# bench/run.sh baseline: case value (lower is better)"
+        echo "# recorded on $(uname -m), $(nproc) cpus, $($CXX --version | head -1)"
+        cat "$RESULTS"
+    } > "$BASELINE"
+    echo "baseline updated: $(wc -l < "$RESULTS") cases"
+    exit 0
+fi
+
+[ -f "$BASELINE" ] || { echo "no baseline; run $0 --update"; exit 1; }
+awk -v tol="$TOLERANCE" '
+    FNR == NR { if ($1 !~ /^#/) base[$1] = $2; next }
+    {
+        status = "new"
+        ratio = ""
+        if ($1 in base && base[$1] > 0) {
+            ratio = sprintf("%.2f", $2 / base[$1])
+            status = $2 > base[$1] * (1 + tol) ? "REGRESSION" : "ok"
+            if (status == "REGRESSION") failed++
+        }
+        printf "%-26s %12s %12s %6s  %s\n", $1, $2, ($1 in base ? base[$1] : "-"), ratio, status
+    }
+    END { if (failed) { print failed " case(s) regressed"; exit 1 } print "no regressions" }
+' "$BASELINE" "$RESULTS"
@@ -1,169 +1,385 @@
 #include <iostream>
-#include <fstream>
 #include <cstring>
-#include <sstream>
 #include <map>
 #include <string>
 #include <cctype>  
 #include <algorithm> 
 #include <vector>
-#include <iomanip>
+#include <string_view>
+#include <climits>
+#include <array>
+#include <atomic>
+#include <thread>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 using namespace std; 
 
 //------------------------------------------------------------------------------------------------------
 
-static ifstream inputFile;  
-map<string, int> symbolTable; 
-map<string, pair<int,bool> > symbolUsed; 
 vector<int> module_base;       // base addresses for each module
-map<string, string> symbolErrors; 
-vector<bool> usedInInstruction(0,false);  // each symbol in useList is used
 
-const int MAX_LINE_LENGTH = 1024; 
-const int MAX_MACHINE_SIZE = 512;
+/*
+    Limits. Without options the linker runs in strict compatibility mode: a 512-word machine, at
+    most 16 definitions and 16 uses per module, and operands encoded as opcode * 1000 + address,
+    printed as 3-digit locations and 4-digit words. -l lifts them for large programs: 7 address
+    digits, a machine of 10^digits words, and no per-module limits. -w, -m, -d and -u set the
+    address digits, machine size and per-module limits one by one.
+*/
+int addressDigits = 3;
+long long addressRadix = 1000;        // 10^addressDigits: operand = opcode * addressRadix + address
+long long illegalWord = 9999;         // opcode 9 with the largest address, used for illegal opcodes
+long long machineSize = 512;          // words: bounds absolute addresses and the total instruction count
+int maxDefs = 16;
+int maxUses = 16;
 int currentBase = 0;           // track base address of each module
 int moduleNum = 0;             // track current module number
-static int lineNum = 0;             
-static char line[MAX_LINE_LENGTH];   
-static char* nextToken = nullptr;    
+static int lineNum = 0;        // line and offset of the last token, for parse errors
 static int tokenOffset = 0;   
-static int tmp = 0;
-static int tmplinecount = 0; 
-
-//----------------------------------------- helper functions ----------------------------------------------
+static int tmp = 0;            // offset just past the last token; parse errors at EOF point there
+
+//----------------------------------------- symbol table ----------------------------------------------
+
+/*
+    Every symbol name is interned once: its characters are appended to symbolNames and it gets
+    a dense id, and everything the passes know about it lives in symbols[id]. symbolSlots is an
+    open-addressing hash table (linear probing, power-of-two size, at most half full) from name
+    to id. Slots keep the name's hash, so probing only compares names when the hashes match.
+    Nothing is kept sorted; the printouts sort the ids by name when they run.
+*/
+struct Symbol {
+    unsigned int nameOffset;
+    unsigned int nameLength;
+    int address = 0;
+    int module = 0;                // module of the last definition, for the never-used warning
+    bool defined = false;
+    bool used = false;             // referenced by an E instruction
+    bool multiplyDefined = false;
+};
+
+struct SymbolSlot {
+    unsigned int hash;
+    int id;                        // -1: empty
+};
+
+static string symbolNames;
+static vector<Symbol> symbols;
+static vector<SymbolSlot> symbolSlots(1024, SymbolSlot{0, -1});
+
+string_view symbolName(int id) {
+    return string_view(symbolNames.data() + symbols[id].nameOffset, symbols[id].nameLength);
+}
 
+static unsigned int hashName(string_view name) {
+    unsigned int h = 2166136261u;    // FNV-1a
+    for (char c : name) { h = (h ^ (unsigned char)c) * 16777619u; }
+    return h;
+}
 
-bool readNextLine() {
-    if (inputFile.getline(line, MAX_LINE_LENGTH)) {
-        tmplinecount++;
-        nextToken = strtok(line, " \t\n");
-        return true; 
+// slot holding name, or the empty slot where it would go
+static size_t findSlot(string_view name, unsigned int hash) {
+    size_t mask = symbolSlots.size() - 1;
+    size_t slot = hash & mask;
+    while (symbolSlots[slot].id >= 0 && (symbolSlots[slot].hash != hash || symbolName(symbolSlots[slot].id) != name)) {
+        slot = (slot + 1) & mask;
     }
-    return false; 
+    return slot;
+}
+
+int findSymbol(string_view name) {
+    return symbolSlots[findSlot(name, hashName(name))].id;
 }
 
+int internSymbol(string_view name) {
+    unsigned int hash = hashName(name);
+    size_t slot = findSlot(name, hash);
+    if (symbolSlots[slot].id >= 0) { return symbolSlots[slot].id; }
+
+    Symbol sym;
+    sym.nameOffset = symbolNames.size();
+    sym.nameLength = name.size();
+    symbolNames.append(name.data(), name.size());
+    int id = symbols.size();
+    symbols.push_back(sym);
+    symbolSlots[slot] = SymbolSlot{hash, id};
+
+    if (symbols.size() * 2 > symbolSlots.size()) {
+        vector<SymbolSlot> old(symbolSlots.size() * 2, SymbolSlot{0, -1});
+        old.swap(symbolSlots);
+        size_t mask = symbolSlots.size() - 1;
+        for (const SymbolSlot& entry : old) {
+            if (entry.id < 0) { continue; }
+            size_t to = entry.hash & mask;
+            while (symbolSlots[to].id >= 0) { to = (to + 1) & mask; }
+            symbolSlots[to] = entry;
+        }
+    }
+    return id;
+}
 
-void updateTokenOffset(char* token) {
-    lineNum = tmplinecount; 
-    tokenOffset = token - line + 1; 
+// ids of the defined symbols in name order
+vector<int> definedSymbolsByName() {
+    vector<int> ids;
+    for (int i = 0; i < (int)symbols.size(); i++) {
+        if (symbols[i].defined) { ids.push_back(i); }
+    }
+    sort(ids.begin(), ids.end(), [](int a, int b) { return symbolName(a) < symbolName(b); });
+    return ids;
 }
 
+//---------------------------------------- intermediate representation ----------------------------------
+
+/*
+    Pass1 reads the file once and keeps what Pass2 needs: for every module its definitions, its
+    use list as symbol ids and its instructions, each a span of the shared arrays below. Pass2
+    resolves over these and never reads the file again. Counts are kept as read, so a module cut
+    off by the end of the file has -1 for the counts it never got.
+*/
+struct Instruction {
+    char mode;
+    long long operand;
+};
+
+struct Module {
+    int defBegin, defCount;       // in moduleDefs
+    int useBegin, useCount;       // in moduleUses
+    int instBegin, instCount;     // in instructions
+};
+
+vector<Module> modules;
+vector<pair<int, int> > moduleDefs;   // (symbol id, value) in input order
+vector<int> moduleUses;               // symbol ids
+vector<Instruction> instructions;
+vector<int> symbolOrder;              // defined symbols in name order, sorted once after Pass1
 
-char* fetchNextToken() {
-    char* token = nextToken; 
-    if (token != nullptr) {
-        updateTokenOffset(token); 
-        nextToken = strtok(nullptr, " \t\n"); 
-        tmp = tokenOffset + strlen(token);
-        return token; 
+//----------------------------------------- helper functions ----------------------------------------------
+
+
+/*
+    The object file is mapped read-only and tokens are string_views into the mapping; nothing
+    is copied and lines can be any length. Tokens are separated by blanks, tabs and newlines,
+    and the tokenizer counts lines as it passes them.
+*/
+static const char* input = nullptr;      // the mapped file
+static const char* inputEnd = nullptr;
+static const char* cursor = nullptr;
+static const char* lineStart = nullptr;
+static int currentLine = 1;              // line the cursor is on
+static string inputCopy;                 // holds the file when it cannot be mapped (pipes, empty files)
+
+bool openInput(const char* path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) { return false; }
+    struct stat st;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+        void* map = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map != MAP_FAILED) {
+            madvise(map, st.st_size, MADV_SEQUENTIAL);
+            input = static_cast<const char*>(map);
+            inputEnd = input + st.st_size;
+        }
+    }
+    if (input == nullptr) {
+        char buf[1 << 16];
+        ssize_t n;
+        while ((n = read(fd, buf, sizeof(buf))) > 0) { inputCopy.append(buf, n); }
+        input = inputCopy.data();
+        inputEnd = input + inputCopy.size();
     }
-    nextToken = nullptr; 
-    return nullptr; 
+    close(fd);
+    cursor = lineStart = input;
+    return true;
 }
 
-// Tokenizer
-char* getToken() {
-    if (nextToken == nullptr) {
-        if (!readNextLine()) {
-            if (strlen(line) == 0 || line[strlen(line) - 1] == '\n') {
-                tokenOffset = tmp; 
-                return nullptr; 
-            }
-            lineNum = tmplinecount; 
-            tokenOffset = strlen(line) + 1; 
-            return nullptr; 
+void closeInput() {
+    if (inputCopy.empty() && input != nullptr && inputEnd > input) { munmap(const_cast<char*>(input), inputEnd - input); }
+    input = inputEnd = cursor = lineStart = nullptr;
+}
+
+static inline bool isBlank(char c) { return c == ' ' || c == '\t'; }
+static inline bool isDelimiter(char c) { return c == ' ' || c == '\t' || c == '\n'; }
+static inline bool isDigit(char c) { return (unsigned char)(c - '0') < 10; }
+static inline bool isAlpha(char c) { return (unsigned char)((c | 0x20) - 'a') < 26; }
+static inline bool isAlnum(char c) { return isDigit(c) || isAlpha(c); }
+
+// Tokenizer; an empty view means end of file
+string_view getToken() {
+    while (true) {
+        while (cursor < inputEnd && isBlank(*cursor)) { cursor++; }
+        if (cursor == inputEnd) {
+            tokenOffset = tmp; 
+            return string_view(); 
         }
-        if (nextToken == nullptr) {
-            tokenOffset = strlen(line) + 1; 
-            return getToken(); 
+        if (*cursor == '\n') {
+            cursor++;
+            currentLine++;
+            lineStart = cursor;
+            continue;
         }
+        const char* start = cursor;
+        while (cursor < inputEnd && !isDelimiter(*cursor)) { cursor++; }
+        lineNum = currentLine;
+        tokenOffset = start - lineStart + 1;
+        tmp = tokenOffset + (cursor - start);
+        return string_view(start, cursor - start);
     }
-    return fetchNextToken(); 
 }
 
 
-void printError(int ruleNumber, const string& additionalInfo = "", bool inlinePrint = false) {
-    std::string errorMessage;
+//------------------------------------------ Output -------------------------------------------------
+
+/*
+    Everything the linker prints is appended to one OutputBuffer, written to stdout once at the
+    end (or before a parse error exits). Numbers are formatted two digits at a time from a table
+    of digit pairs instead of through setw/setfill, and lines end in '\n' rather than endl, so
+    there is no flush per line. Pass2 workers fill one buffer per module and Pass2 appends them.
+*/
+static const array<char, 200> digitPairs = [] {
+    array<char, 200> pairs{};
+    for (int i = 0; i < 100; i++) { pairs[2 * i] = '0' + i / 10; pairs[2 * i + 1] = '0' + i % 10; }
+    return pairs;
+}();
+
+class OutputBuffer {
+    private:
+        string buffer;
+
+    public:
+        void put(string_view text) { buffer.append(text.data(), text.size()); }
+        void put(char c) { buffer.push_back(c); }
+        void put(const OutputBuffer& other) { buffer.append(other.buffer); }
+
+        // decimal, zero-padded to width; wider values are written whole, as with setw
+        void putNumber(long long value, int width = 0) {
+            char digits[24];
+            char* end = digits + sizeof(digits);
+            char* p = end;
+            unsigned long long v = value < 0 ? 0ULL - (unsigned long long)value : value;
+            while (v >= 100) {
+                unsigned r = v % 100;
+                v /= 100;
+                p -= 2;
+                memcpy(p, &digitPairs[2 * r], 2);
+            }
+            if (v >= 10) { p -= 2; memcpy(p, &digitPairs[2 * v], 2); }
+            else { *--p = '0' + v; }
+            if (value < 0) { *--p = '-'; }
+            if (end - p < width) { buffer.append(width - (end - p), '0'); }
+            buffer.append(p, end - p);
+        }
+
+        // memory map entry "NNN: WWWW" without the line end, which is '\n' or an error message
+        void putWord(int location, long long word) {
+            putNumber(location, addressDigits);
+            buffer.append(": ", 2);
+            putNumber(word, addressDigits + 1);
+        }
+
+        void flush() {
+            cout.write(buffer.data(), buffer.size());
+            cout.flush();
+            buffer.clear();
+        }
+};
+
+OutputBuffer output;
+
+void printError(OutputBuffer& out, int ruleNumber, string_view additionalInfo = "", bool inlinePrint = false) {
     switch (ruleNumber) {
         case 2:
-            errorMessage = " Error: This variable is multiple times defined; first value used"; break;
+            out.put(" Error: This variable is multiple times defined; first value used"); break;
         case 3:
-            errorMessage = " Error: " + additionalInfo + " is not defined; zero used"; break;
+            out.put(" Error: "); out.put(additionalInfo); out.put(" is not defined; zero used"); break;
         case 6:
-            errorMessage = " Error: External operand exceeds length of uselist; treated as relative=0"; break;
+            out.put(" Error: External operand exceeds length of uselist; treated as relative=0"); break;
         case 8:
-            errorMessage = " Error: Absolute address exceeds machine size; zero used"; break;
+            out.put(" Error: Absolute address exceeds machine size; zero used"); break;
         case 9:
-            errorMessage = " Error: Relative address exceeds module size; relative zero used"; break;
+            out.put(" Error: Relative address exceeds module size; relative zero used"); break;
         case 10:
-            errorMessage = " Error: Illegal immediate operand; treated as 999"; break;
+            out.put(" Error: Illegal immediate operand; treated as "); out.putNumber(addressRadix - 1); break;
         case 11:
-            errorMessage = " Error: Illegal opcode; treated as 9999"; break;
+            out.put(" Error: Illegal opcode; treated as "); out.putNumber(illegalWord); break;
         case 12:
-            errorMessage = " Error: Illegal module operand ; treated as module=0"; break;
+            out.put(" Error: Illegal module operand ; treated as module=0"); break;
         default: break;
     }
-    if (inlinePrint) { std::cout << errorMessage; } 
-    else { std::cout << errorMessage << std::endl; }
+    if (!inlinePrint) { out.put('\n'); }
 
 }
 
-void printWarning(int ruleNumber, int moduleNum, const string& symbol = "", int value = 0, int maxLimit = 0, int useListIndex=0) {
-    string message;
+void printWarning(int ruleNumber, int moduleNum, string_view symbol = "", int value = 0, int maxLimit = 0, int useListIndex=0) {
+    if (ruleNumber != 4 && ruleNumber != 5 && ruleNumber != 6 && ruleNumber != 7 && ruleNumber != 13) {
+        output.put("Warning: Unknown warning rule encountered.\n");
+        return;
+    }
+    output.put("Warning: Module ");
+    output.putNumber(moduleNum);
+    output.put(": ");
     switch (ruleNumber) {
         case 4:  // symbol defined but never used
-            message = "Warning: Module " + std::to_string(moduleNum) + ": " + symbol + " was defined but never used";
+            output.put(symbol); output.put(" was defined but never used");
             break;
         case 5:  // symbol exceeds module size
-            message = "Warning: Module " + std::to_string(moduleNum) + ": " + symbol + "=" + std::to_string(value) 
-                      + " valid=[0.." + std::to_string(maxLimit-1) + "] assume zero relative";
+            output.put(symbol); output.put('='); output.putNumber(value);
+            output.put(" valid=[0.."); output.putNumber(maxLimit - 1); output.put("] assume zero relative");
             break;
         case 6:  // symbol redefinition ignored
-            message = "Warning: Module " + std::to_string(moduleNum) + ": " +  symbol + " redefinition ignored";
+            output.put(symbol); output.put(" redefinition ignored");
             break;
         case 7:  // uselist symbol not used
-            message = "Warning: Module " + std::to_string(moduleNum) + ": " +  "uselist[" +  std::to_string(useListIndex) +"]"+ "="+ symbol + " was not used";
+            output.put("uselist["); output.putNumber(useListIndex); output.put("]="); output.put(symbol); output.put(" was not used");
             break;
         case 13:  // uselist symbol referenced multiple times but not used
-            message = "Warning: Module " + std::to_string(moduleNum) + ": uselist symbol " + symbol + " was referenced but not used";
-            break;
-        default:
-            message = "Warning: Unknown warning rule encountered.";
+            output.put("uselist symbol "); output.put(symbol); output.put(" was referenced but not used");
             break;
     }
-    std::cout << message << std::endl;
+    output.put('\n');
 }
 
 void parseErrors(int errcode) {
     static const std::string errstr[] = {
-        "TOO_MANY_DEF_IN_MODULE",   // > 16 symbol definitions in a module.
-        "TOO_MANY_USE_IN_MODULE",   // > 16 uses in a module.
-        "TOO_MANY_INSTR",           // total number of instructions > 512.
+        "TOO_MANY_DEF_IN_MODULE",   // > maxDefs symbol definitions in a module.
+        "TOO_MANY_USE_IN_MODULE",   // > maxUses uses in a module.
+        "TOO_MANY_INSTR",           // total number of instructions > machineSize.
         "NUM_EXPECTED",             // not a number 
         "SYM_EXPECTED",             // not a symbol 
         "MARIE_EXPECTED",           // !=addressing mode (M/A/R/I/E) 
         "SYM_TOO_LONG"              // symbol name > maximum allowed length.
     };
-    std::cout << "Parse Error line " << lineNum << " offset " << tokenOffset << ": " << errstr[errcode] << endl;
+    output.put("Parse Error line "); output.putNumber(lineNum);
+    output.put(" offset "); output.putNumber(tokenOffset);
+    output.put(": "); output.put(errstr[errcode]); output.put('\n');
+    output.flush();
     exit(1);  
 }
 
-int readInt() {
-    char* token = getToken();
-    if (token == nullptr) {
+// digits only; values past LONG_MAX saturate, as with strtol
+long readNumber() {
+    string_view token = getToken();
+    if (token.empty()) {
         return -1 ;
     }
-    for (int i = 0; token[i] != '\0'; i++) {
-        if (!isdigit(token[i])) {
+    long value = 0;
+    for (char c : token) {
+        if (!isDigit(c)) {
             parseErrors(3);  // NUM_EXPECTED: Token is not a valid number
         }
+        int digit = c - '0';
+        value = value > (LONG_MAX - digit) / 10 ? LONG_MAX : value * 10 + digit;
     }
-    return atoi(token);
+    return value;
+}
+
+// truncated to int like atoi
+int readInt() {
+    return (int)readNumber();
 }
 
 char readMARIE() {
-    char* token = getToken();  
-    if (token == nullptr || strlen(token) != 1) {
+    string_view token = getToken();  
+    if (token.size() != 1) {
         parseErrors(5);  // MARIE_EXPECTED: Token not found or invalid length
     }
     char mode = token[0];  
@@ -173,36 +389,38 @@ char readMARIE() {
     return mode;  
 }
 
-std::string readSym() {
-    char* token = getToken();  
-    if (token == nullptr) { // no symbol is found
+// the view points into the mapped file
+string_view readSym() {
+    string_view token = getToken();  
+    if (token.empty()) { // no symbol is found
         parseErrors(4);  // SYM_EXPECTED: No token found
     }
-    if (!isalpha(token[0])) {
+    if (!isAlpha(token[0])) {
         parseErrors(4);  // SYM_EXPECTED: Token is not a valid symbol
     }
-    for (int i = 1; token[i] != '\0'; i++) {
-        if (!isalnum(token[i])) {
+    for (size_t i = 1; i < token.size(); i++) {
+        if (!isAlnum(token[i])) {
             parseErrors(4);  // SYM_EXPECTED: Token is not a valid symbol
         }
     }
-    return string(token);  
+    return token;  
 }
 //---------------------------------------------------------------------------------------------------
 
 //---------------------------------- Pass 1 helper functon--------------------------------------------
-void createSymbolTable(const string& sym, int val, int moduleSize ){    
+void createSymbolTable(int id, int val, int moduleSize ){    
+    Symbol& sym = symbols[id];
     if (val > moduleSize) { 
-        printWarning(5, moduleNum, sym, val, moduleSize);  
+        printWarning(5, moduleNum, symbolName(id), val, moduleSize);  
         val = 0;  // assume zero relative if value is larger than module size
     }
-    if (symbolTable.find(sym) == symbolTable.end()) {
-        symbolTable[sym] = currentBase + val;
-        symbolErrors[sym] = "";   
+    if (!sym.defined) {
+        sym.defined = true;
+        sym.address = currentBase + val;
     } 
     else {
-        printWarning(6, moduleNum, sym);  // print the warning immediately
-        symbolErrors[sym] = " Error: This variable is multiple times defined; first value used"; 
+        printWarning(6, moduleNum, symbolName(id));  // print the warning immediately
+        sym.multiplyDefined = true;
     }
 }
 //---------------------------------------------------------------------------------------------------
@@ -213,33 +431,47 @@ void Pass1() {
         // DEF
         int defcount = readInt();
         if (defcount < 0) { break; } // eof
-        if (defcount > 16) { parseErrors(0); } // TOO_MANY_DEF_IN_MODULE
-        map<string, int> temp; 
+        if (defcount > maxDefs) { parseErrors(0); } // TOO_MANY_DEF_IN_MODULE
+        Module mod;
+        mod.defBegin = moduleDefs.size();
+        mod.defCount = defcount;
         for (int i = 0; i < defcount; i++) {
-            string sym = readSym();  
+            int id = internSymbol(readSym());  
             int val = readInt();    
-           temp[sym] = val;
-           symbolUsed[sym] = std::make_pair(moduleNum, false); 
+            moduleDefs.push_back(make_pair(id, val));
+            symbols[id].module = moduleNum;
         }
+        vector<pair<int, int> > temp(moduleDefs.begin() + mod.defBegin, moduleDefs.end());
+        // the module's definitions are entered in name order; a name defined twice in one module keeps its last value
+        stable_sort(temp.begin(), temp.end(), [](const pair<int, int>& a, const pair<int, int>& b) {
+            return symbolName(a.first) < symbolName(b.first);
+        });
    
-        // USE (read but ignore)
+        // USE
         int usecount = readInt();
-        if (usecount > 16) { parseErrors(1); } // TOO_MANY_USE_IN_MODULE
+        if (usecount > maxUses) { parseErrors(1); } // TOO_MANY_USE_IN_MODULE
+        mod.useBegin = moduleUses.size();
+        mod.useCount = usecount;
         for (int i = 0; i < usecount; i++) {
-            string sym = readSym();  //  read and discard symbol for now
+            moduleUses.push_back(internSymbol(readSym()));
         }
         
         // INSTRUCTIONS
         int instcount = readInt();
-        for (map<string, int>::const_iterator it = temp.begin(); it != temp.end(); ++it) {
-            createSymbolTable(it->first, it->second, instcount);
+        for (size_t i = 0; i < temp.size(); i++) {
+            if (i + 1 < temp.size() && temp[i + 1].first == temp[i].first) { continue; }
+            createSymbolTable(temp[i].first, temp[i].second, instcount);
         }
-        if (instcount + currentBase > 512) { parseErrors(2); } // TOO_MANY_INSTR
-        // skip actual instructions for now
+        if ((long long)instcount + currentBase > machineSize) { parseErrors(2); } // TOO_MANY_INSTR
+        mod.instBegin = instructions.size();
+        mod.instCount = instcount;
         for (int i = 0; i < instcount; i++) {
-            char mode = readMARIE();  
-            int operand = readInt();    
+            Instruction inst;
+            inst.mode = readMARIE();  
+            inst.operand = illegalWord <= INT_MAX ? readInt() : readNumber();    // int, as always, while words fit one
+            instructions.push_back(inst);
         }
+        modules.push_back(mod);
 
 
         // update base address for the next module
@@ -249,230 +481,300 @@ void Pass1() {
 
     }
 
-    std::cout << "Symbol Table" << endl;
-    for (map<string, int>::const_iterator it = symbolTable.begin(); it != symbolTable.end(); ++it) {
-        std::cout << it->first << "=" << it->second;
-        if (!symbolErrors[it->first].empty()) {
-            std::cout << symbolErrors[it->first];  
+    output.put("Symbol Table\n");
+    symbolOrder = definedSymbolsByName();
+    for (int id : symbolOrder) {
+        output.put(symbolName(id));
+        output.put('=');
+        output.putNumber(symbols[id].address);
+        if (symbols[id].multiplyDefined) {
+            printError(output, 2, "", true);
         }
-        std::cout << endl;
+        output.put('\n');
     }
-    std::cout << endl;
+    output.put('\n');
 }
 
 //---------------------------------------------------------------------------------------------------
 
 //--------------------------------------- Pass 2 helper functons -------------------------------------
 
-void parseM(int operand, int resolvedAddress, int instructionIndex) {
-    int moduleIndex = operand % 1000;  
-    int opcode = operand / 1000;       
+/*
+    Once Pass1 has fixed the module bases and the symbol table, a module's relocation depends only
+    on its own instructions and use list and on those read-only tables. Pass2 relocates the
+    modules on a pool of workers that each take the next unrelocated module, as run_devices()
+    does with devices in ioschedlab4.cpp. Every module is written to its own buffer, together with
+    which use list entries its E instructions referenced. The buffers are then printed in module
+    order, and the use list warnings and used flags are merged there, so the output is the same
+    for any number of workers.
+
+    A module's use list is its span of moduleUses. Before its instructions are relocated, each
+    entry is resolved once to the symbol's address (or UNDEFINED_ADDRESS), so an E instruction
+    is a single index into that array.
+*/
+struct RelocatedModule {
+    OutputBuffer text;             // memory map lines
+    vector<bool> usedIndex;        // use list entries referenced by an E instruction
+};
+
+const long long UNDEFINED_ADDRESS = -1;
+
+int jobs = std::max(1u, thread::hardware_concurrency());   // -j
+const size_t MODULES_PER_WORKER = 16;     // below this, extra workers cost more than they save
+
+
+void parseM(OutputBuffer& out, long long operand, long long resolvedAddress, int instructionIndex) {
+    long long moduleIndex = operand % addressRadix;  
+    long long opcode = operand / addressRadix;       
 
     // if operand references a valid module
-    if (moduleIndex >= module_base.size()) {
+    if (moduleIndex < 0 || moduleIndex >= (long long)module_base.size()) {
         //  module index out of range -> eeror and assume base of module 0
-        resolvedAddress = opcode * 1000;  // reset operand to zero -> assume base of module 0
-        cout << std::setw(3) << std::setfill('0') << instructionIndex << ": " 
-             << std::setw(4) << std::setfill('0') << resolvedAddress << " ";
-        printError(12);  
+        resolvedAddress = opcode * addressRadix;  // reset operand to zero -> assume base of module 0
+        out.putWord(instructionIndex, resolvedAddress); out.put(' ');
+        printError(out, 12);  
     } 
     else {
-        resolvedAddress = opcode * 1000 + module_base[moduleIndex];
-        cout << std::setw(3) << std::setfill('0') << instructionIndex << ": " 
-             << std::setw(4) << std::setfill('0') << resolvedAddress << endl;
+        resolvedAddress = opcode * addressRadix + module_base[moduleIndex];
+        out.putWord(instructionIndex, resolvedAddress); out.put('\n');
     }
 }
 
 
-void parseA(int operand, int resolvedAddress, int instructionIndex){
-    if (operand % 1000 >= MAX_MACHINE_SIZE) {
-        resolvedAddress = operand / 1000 * 1000;
-        cout << std::setw(3) << std::setfill('0') << instructionIndex << ": " 
-            << std::setw(4) << std::setfill('0') << resolvedAddress<< " ";
-        printError(8);  // bbsolute address > machine size
+void parseA(OutputBuffer& out, long long operand, long long resolvedAddress, int instructionIndex){
+    if (operand % addressRadix >= machineSize) {
+        resolvedAddress = operand / addressRadix * addressRadix;
+        out.putWord(instructionIndex, resolvedAddress); out.put(' ');
+        printError(out, 8);  // bbsolute address > machine size
     } 
     else {
         resolvedAddress = operand;
-        cout << std::setw(3) << std::setfill('0') << instructionIndex << ": " 
-                << std::setw(4) << std::setfill('0') << resolvedAddress << endl;
+        out.putWord(instructionIndex, resolvedAddress); out.put('\n');
     }
 }
 
-void parseR(int operand, int resolvedAddress, int instcount, int instructionIndex){
+void parseR(OutputBuffer& out, long long operand, long long resolvedAddress, int instcount, int instructionIndex, int base){
   
-    if (operand % 1000 >= instcount) {
-        resolvedAddress = (operand / 1000) * 1000 + instructionIndex;
-        cout << std::setw(3) << std::setfill('0') << instructionIndex << ": " 
-            << std::setw(4) << std::setfill('0') << resolvedAddress<< " ";
-        printError(9);  // relative address > module size
+    if (operand % addressRadix >= instcount) {
+        resolvedAddress = (operand / addressRadix) * addressRadix + instructionIndex;
+        out.putWord(instructionIndex, resolvedAddress); out.put(' ');
+        printError(out, 9);  // relative address > module size
     } 
     else {
-        resolvedAddress = operand + currentBase;
-        cout << std::setw(3) << std::setfill('0') << instructionIndex << ": " 
-            << std::setw(4) << std::setfill('0') << resolvedAddress << endl;
+        resolvedAddress = operand + base;
+        out.putWord(instructionIndex, resolvedAddress); out.put('\n');
     }
 
 }
 
-void parseI(int operand, int resolvedAddress, int instructionIndex){
-    if (operand%1000 >= 900) { 
-        resolvedAddress = 9999;
-        cout << std::setw(3) << std::setfill('0') << instructionIndex << ": " 
-            << std::setw(4) << std::setfill('0') << resolvedAddress<< " ";
-        printError(10);  // Illegal immediate operand
+void parseI(OutputBuffer& out, long long operand, long long resolvedAddress, int instructionIndex){
+    if (operand% addressRadix >= addressRadix / 10 * 9) { 
+        resolvedAddress = illegalWord;
+        out.putWord(instructionIndex, resolvedAddress); out.put(' ');
+        printError(out, 10);  // Illegal immediate operand
     }
     else {
         resolvedAddress = operand;
-        cout << std::setw(3) << std::setfill('0') << instructionIndex << ": " 
-            << std::setw(4) << std::setfill('0') << resolvedAddress << endl;
+        out.putWord(instructionIndex, resolvedAddress); out.put('\n');
     }
 }
 
-void parseE(int operand, int resolvedAddress, int instructionIndex, int usecount,
-            vector<string> useList, int moduleNum){ 
-int useIndex = operand % 1000;
-    if (useIndex >= usecount) {
-        resolvedAddress = operand / 1000 * 1000;
-        cout << std::setw(3) << std::setfill('0') << instructionIndex << ": " 
-             << std::setw(4) << std::setfill('0') << resolvedAddress<< " ";
-        printError(6);  // external operand > length of uselist
+void parseE(OutputBuffer& out, long long operand, long long resolvedAddress, int instructionIndex, int usecount,
+            const int* useList, const long long* useAddress, vector<bool>& usedIndex){ 
+    long long useIndex = operand % addressRadix;
+    if (useIndex < 0 || useIndex >= usecount) {
+        resolvedAddress = operand / addressRadix * addressRadix;
+        out.putWord(instructionIndex, resolvedAddress); out.put(' ');
+        printError(out, 6);  // external operand > length of uselist
     } 
     else {
-        string sym = useList[useIndex];
-        usedInInstruction[useIndex] = true;
-
-        if (symbolTable.find(sym) != symbolTable.end()) {
-            resolvedAddress = operand / 1000 * 1000 + symbolTable[sym];
-            symbolUsed[sym] = std::make_pair(moduleNum, true);
-            cout << std::setw(3) << std::setfill('0') << instructionIndex << ": " 
-                   << std::setw(4) << std::setfill('0') << resolvedAddress << endl;
+        usedIndex[useIndex] = true;
+
+        if (useAddress[useIndex] != UNDEFINED_ADDRESS) {
+            resolvedAddress = operand / addressRadix * addressRadix + useAddress[useIndex];
+            out.putWord(instructionIndex, resolvedAddress); out.put('\n');
         } 
         else {
-            resolvedAddress = operand / 1000 * 1000;
-            cout << std::setw(3) << std::setfill('0') << instructionIndex << ": " 
-                 << std::setw(4) << std::setfill('0') << resolvedAddress<< " ";
-            printError(3, sym);  // Symbol not defined
+            resolvedAddress = operand / addressRadix * addressRadix;
+            out.putWord(instructionIndex, resolvedAddress); out.put(' ');
+            printError(out, 3, symbolName(useList[useIndex]));  // Symbol not defined
         }
     }
 }
 
-int checkOpcode(int opcode, int instructionIndex) {
+long long checkOpcode(OutputBuffer& out, long long opcode, int instructionIndex) {
     if (opcode < 0 || opcode > 9) {  
-        cout << std::setw(3) << std::setfill('0') << instructionIndex << ": " 
-                 << std::setw(4) << std::setfill('0') << 9999<< " ";
-        printError(11);  // illegal opcode
-        return 9999;  
+        out.putWord(instructionIndex, illegalWord); out.put(' ');
+        printError(out, 11);  // illegal opcode
+        return illegalWord;  
     }
     return opcode;
 }
 
 //----------------------------------------------------------------------------------------------------
 //------------------------------------ Pass 2 --------------------------------------------------------
-void Pass2() {
-    int instructionIndex = 0;
-    cout << "Memory Map" << endl;
-
-    while (true) {
-        // DEF (read but ignore)
-        int defcount = readInt();
-        if (defcount < 0) { break; }  // eof
-        for (int i = 0; i < defcount; i++) {
-            string sym = readSym();
-            int val = readInt();
-        }
-        
-        // USE
-        int usecount = readInt();
-        vector<string> useList(usecount);      
-        usedInInstruction.resize(usecount, false); 
-        for (int i = 0; i < usecount; i++) {
-            useList[i] = readSym();
+void relocateModule(size_t m, RelocatedModule& result) {
+    const Module& mod = modules[m];
+    OutputBuffer& out = result.text;
+    int base = module_base[m];
+    int instructionIndex = base;
+
+    // USE
+    int usecount = std::max(0, mod.useCount);     // -1 when the input ends before the use list
+    const int* useList = moduleUses.data() + mod.useBegin;
+    thread_local vector<long long> useAddress;      // reused by each worker across its modules
+    useAddress.resize(usecount);
+    for (int i = 0; i < usecount; i++) {
+        const Symbol& sym = symbols[useList[i]];
+        useAddress[i] = sym.defined ? sym.address : UNDEFINED_ADDRESS;
+    }
+    result.usedIndex.assign(usecount, false); 
+
+    // INSTRUCTIONS
+    int instcount = mod.instCount;
+    for (int i = 0; i < instcount; i++) {
+        char mode = instructions[mod.instBegin + i].mode;
+        long long operand = instructions[mod.instBegin + i].operand;
+        long long resolvedAddress = 0;
+        long long opcode = operand / addressRadix;  
+        long long checkedOpcode = checkOpcode(out, opcode,instructionIndex);  
+
+        switch (mode) {
+            case 'R':  
+                if (checkedOpcode == illegalWord)  resolvedAddress = checkedOpcode;
+                else parseR(out, operand, resolvedAddress, instcount, instructionIndex, base);
+                break;
+            case 'I': 
+                if (checkedOpcode == illegalWord)  resolvedAddress = checkedOpcode;
+                else parseI(out, operand, resolvedAddress, instructionIndex);
+                break;
+            case 'E': 
+                if (checkedOpcode == illegalWord)  resolvedAddress = checkedOpcode;
+                else parseE(out, operand, resolvedAddress, instructionIndex, usecount, useList, useAddress.data(), result.usedIndex);
+                break;
+            case 'A':  
+                if (checkedOpcode == illegalWord)  resolvedAddress = checkedOpcode;
+                else parseA(out, operand, resolvedAddress, instructionIndex);
+                break;
+             case 'M': 
+                if (checkedOpcode == illegalWord)  resolvedAddress = checkedOpcode;
+                else parseM(out, operand, resolvedAddress, instructionIndex);
+                break;
+            default:
+                out.put("Unknown addressing mode: "); out.put(mode); out.put('\n');
+                break;
         }
+        instructionIndex++;
+    }
+}
 
-        // INSTRUCTIONS
-        int instcount = readInt();
-        for (int i = 0; i < instcount; i++) {
-            char mode = readMARIE();
-            int operand = readInt();
-            int resolvedAddress = 0;
-            int opcode = operand / 1000;  
-            int checkedOpcode = checkOpcode(opcode,instructionIndex);  
-    
-            switch (mode) {
-                case 'R':  
-                    if (checkedOpcode == 9999)  resolvedAddress = checkedOpcode;
-                    else parseR(operand, resolvedAddress, instcount, instructionIndex);
-                    break;
-                case 'I': 
-                    if (checkedOpcode == 9999)  resolvedAddress = checkedOpcode;
-                    else parseI(operand, resolvedAddress, instructionIndex);
-                    break;
-                case 'E': 
-                    if (checkedOpcode == 9999)  resolvedAddress = checkedOpcode;
-                    else parseE(operand, resolvedAddress, instructionIndex, usecount, useList, moduleNum);
-                    break;
-                case 'A':  
-                    if (checkedOpcode == 9999)  resolvedAddress = checkedOpcode;
-                    else parseA(operand, resolvedAddress, instructionIndex);
-                    break;
-                 case 'M': 
-                    if (checkedOpcode == 9999)  resolvedAddress = checkedOpcode;
-                    else parseM(operand, resolvedAddress, instructionIndex);
-                    break;
-                default:
-                    cout << "Unknown addressing mode: " << mode << endl;
-                    break;
-            }
-            instructionIndex++;
-        }
+void Pass2() {
+    output.put("Memory Map\n");
 
-        //symbols in  use list ->  not used in the current module
-        for (int i = 0; i < usecount; i++) {
-            if (!usedInInstruction[i]) {
-                printWarning(7, moduleNum, useList[i], 0,0,i);  //uselist symbol not used
-            }
-        }
-        currentBase += instcount;
-        moduleNum++;
+    vector<RelocatedModule> relocated(modules.size());
+    atomic<size_t> nextModule(0);
+    auto worker = [&relocated, &nextModule]() {
+        for (size_t m = nextModule++; m < modules.size(); m = nextModule++) { relocateModule(m, relocated[m]); }
+    };
+    int workers = std::min<size_t>(jobs, modules.size() / MODULES_PER_WORKER + 1);
+    if (workers <= 1) { worker(); }
+    else {
+        vector<thread> pool;
+        for (int i = 0; i < workers; i++) { pool.emplace_back(worker); }
+        for (thread& t : pool) { t.join(); }
     }
-    cout<<""<<endl;
-    for (std::map<std::string, std::pair<int, bool> >::iterator it = symbolUsed.begin(); it != symbolUsed.end(); ++it) {
-        int modn = it->second.first;  
-        bool used = it->second.second;      
 
-        if (!used) {
-            printWarning(4, modn, it->first, 0, 0);  
+    // merge in module order
+    for (size_t m = 0; m < modules.size(); m++) {
+        RelocatedModule& result = relocated[m];
+        output.put(result.text);
+        for (size_t i = 0; i < result.usedIndex.size(); i++) {
+            int id = moduleUses[modules[m].useBegin + i];
+            if (result.usedIndex[i]) { symbols[id].used = true; }
+            else { printWarning(7, m, symbolName(id), 0,0,i); }  //uselist symbol not used in the current module
         }
+        result = RelocatedModule();
     }
-    cout<<""<<endl;
+    output.put('\n');
+    for (int id : symbolOrder) {
+        if (!symbols[id].used) {
+            printWarning(4, symbols[id].module, symbolName(id), 0, 0);  
+        }
+    }
+    output.put('\n');
 }
 //---------------------------------------------------------------------------------------------------
 
+//------------------------------------------ PASS TIMING --------------------------------------------
+
+/*
+    Build with -DLINKER_PROFILE to print the wall time of each pass to stderr as
+    "pass1_ns <n> pass2_ns <n>". Pass1 covers reading and checking the input, Pass2 relocation
+    and writing the output. bench/run.sh divides them by the input size for throughput.
+*/
+#ifdef LINKER_PROFILE
+#include <chrono>
+static long long profile_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+#endif
+
 //------------------------------------------ MAIN ---------------------------------------------------
 
 int main(int argc, char* argv[]) {
-    if (argc < 2) {
-        cerr << "Usage: " << argv[0] << " <input_file>" << endl;
+    bool lift = false;
+    int digits = 0;
+    long long machine = 0;
+    int defs = 0, uses = 0;
+    int opt;
+    while ((opt = getopt(argc, argv, "lw:m:d:u:j:")) != -1) {
+        switch (opt) {
+            case 'l': lift = true; break;
+            case 'w': digits = atoi(optarg); break;
+            case 'm': machine = atoll(optarg); break;
+            case 'd': defs = atoi(optarg); break;
+            case 'u': uses = atoi(optarg); break;
+            case 'j': jobs = atoi(optarg) > 0 ? atoi(optarg) : std::max(1u, thread::hardware_concurrency()); break;
+            default: optind = argc + 1; break;
+        }
+    }
+    if (optind >= argc || digits < 0 || digits > 15 || machine < 0 || defs < 0 || uses < 0) {
+        cerr << "Usage: " << argv[0] << " [-l] [-w address digits] [-m machine size] [-d max defs] [-u max uses] [-j workers] <input_file>" << endl;
         return 1; 
     }
+    if (lift) {
+        addressDigits = 7;
+        maxDefs = maxUses = INT_MAX;
+    }
+    if (digits > 0) { addressDigits = digits; }
+    addressRadix = 1;
+    for (int i = 0; i < addressDigits; i++) { addressRadix *= 10; }
+    illegalWord = addressRadix * 10 - 1;
+    if (lift) { machineSize = addressRadix; }
+    if (machine > 0) { machineSize = machine; }
+    if (defs > 0) { maxDefs = defs; }
+    if (uses > 0) { maxUses = uses; }
  
-    inputFile.open(argv[1]);
-    if (!inputFile.is_open()) {
-        cerr << "Could not open file " << argv[1] << endl;
+    if (!openInput(argv[optind])) {
+        cerr << "Could not open file " << argv[optind] << endl;
         exit(1);
     }
     
+#ifdef LINKER_PROFILE
+    long long pass1_start = profile_ns();
+#endif
     Pass1();
+    closeInput(); 
 
-    // reset for Pass2
-    currentBase = 0;
-    moduleNum = 0;
-    inputFile.clear();  // clear EOF flag
-    inputFile.seekg(0, ios::beg);  // file pointer -> beginning
-
+#ifdef LINKER_PROFILE
+    long long pass2_start = profile_ns();
+#endif
     Pass2();
-
-    inputFile.close(); 
+    output.flush();
+#ifdef LINKER_PROFILE
+    cerr << "pass1_ns " << pass2_start - pass1_start << " pass2_ns " << profile_ns() - pass2_start << endl;
+#endif
     return 0;
 }
 
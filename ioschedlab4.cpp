@@ -17,18 +17,28 @@
 #include <map>
 #include <iostream>
 #include <cstdlib>
+#include <memory_resource>
+#include <unordered_map>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#include "workload.h"
+#include "snapshot.h"
 
 
 using namespace std;
 
-int current_track = 0;
-
 bool vMode = false;
 void log(const std::string& message) {
-    if (vMode) {
-        cout << "[LOG]: " << message << endl;
-    }
+    cout << "[LOG]: " << message << endl;
 }
+// the message is only built under -v; the schedulers log on every add and dispatch
+#define LOG(message) do { if (vMode) log(message); } while (0)
 
 //------------------------------------------------------------------------------------------------------------------------------
 
@@ -37,115 +47,319 @@ struct IORequest {
     int track;
     int start_time = -1;  
     int finish_time = -1; 
+    int stream = 0;        // issuing stream, used by the fair-queueing scheduler
+    int tenant = 0;        // dense id of the stream, indexes the per-tenant report
+    int sector = 0;        // first sector on the track; hashed when the input has no sector column
+    int size = 1;          // sectors transferred
+    bool has_range = false;    // sector and size came from the input
+    int merged_into = -1;      // request this one was merged into, it completes together with it
+    int next_merged = -1;      // chain of requests merged into this one
+    long long measured_ns = -1;    // latency of the real read in replay mode
+    int movement = 0;      // tracks the head travelled to reach this request
 
     IORequest(int arrival_time, int track)
         : arrival_time(arrival_time), track(track) {}
 };
 
+//------------------------------------------------------------------------------------------------------------------------------
+
+/*
+    Seek models (-m). seek_time(0) is always 0: a request on the current track completes at once.
+      l                            linear, one time unit per track (the original model)
+      s[:settle,a,cutoff,b]        settle + a*sqrt(d) below cutoff tracks, linear with slope b above
+      t:<file>                     "distance time" pairs, interpolated linearly between points and
+                                   extrapolated with the last segment's slope
+    Non-zero seeks take at least one time unit so the event clock always moves forward. The input
+    addresses tracks only, with no head or surface, so there is no separate head-switch cost; the
+    settle term is the fixed part of every seek.
+*/
+class SeekModel {
+public:
+    virtual ~SeekModel() {}
+    virtual int seek_time(int distance) const = 0;
+};
+
+class LinearSeek : public SeekModel {
+public:
+    int seek_time(int distance) const override { return distance; }
+};
+
+class SqrtLinearSeek : public SeekModel {
+public:
+    SqrtLinearSeek(double settle, double a, double cutoff, double b)
+        : settle(settle), a(a), cutoff(cutoff), b(b) {}
+
+    int seek_time(int distance) const override {
+        if (distance == 0) { return 0; }
+        double t = distance < cutoff ? settle + a * std::sqrt(static_cast<double>(distance))
+                                     : settle + a * std::sqrt(cutoff) + b * (distance - cutoff);
+        return std::max(1, static_cast<int>(std::ceil(t)));
+    }
+
+private:
+    double settle, a, cutoff, b;
+};
+
+class TableSeek : public SeekModel {
+public:
+    // points sorted by distance; curve[d] is precomputed up to the last point
+    explicit TableSeek(vector<pair<int, double> > points) {
+        std::sort(points.begin(), points.end());
+        if (points.empty() || points[0].first != 0) { points.insert(points.begin(), make_pair(0, 0.0)); }
+        for (size_t i = 1; i < points.size(); ++i) {
+            const pair<int, double>& lo = points[i - 1];
+            const pair<int, double>& hi = points[i];
+            for (int d = lo.first; d < hi.first; ++d) {
+                curve.push_back(lo.second + (hi.second - lo.second) * (d - lo.first) / (hi.first - lo.first));
+            }
+        }
+        curve.push_back(points.back().second);
+        size_t n = points.size();
+        tail_slope = n < 2 ? 1.0 : (points[n - 1].second - points[n - 2].second) / (points[n - 1].first - points[n - 2].first);
+    }
+
+    int seek_time(int distance) const override {
+        if (distance == 0) { return 0; }
+        int last = static_cast<int>(curve.size()) - 1;
+        double t = distance <= last ? curve[distance] : curve[last] + tail_slope * (distance - last);
+        return std::max(1, static_cast<int>(std::ceil(t)));
+    }
+
+private:
+    vector<double> curve;
+    double tail_slope;
+};
+
+SeekModel* make_seek_model(const string& spec) {
+    if (spec.empty() || spec == "l") { return new LinearSeek(); }
+    if (spec[0] == 's') {
+        double p[4] = { 1.0, 3.0, 400.0, 0.075 };   // slope of the sqrt part matches b at the cutoff
+        if (spec.size() > 2 && spec[1] == ':') {
+            std::istringstream iss(spec.substr(2));
+            string field;
+            for (int i = 0; i < 4 && std::getline(iss, field, ','); ++i) { p[i] = atof(field.c_str()); }
+        }
+        return new SqrtLinearSeek(p[0], p[1], p[2], p[3]);
+    }
+    if (spec.compare(0, 2, "t:") == 0) {
+        std::ifstream file(spec.substr(2));
+        if (!file.is_open()) { cerr << "Error: Cannot open seek table " << spec.substr(2) << "." << endl; return nullptr; }
+        vector<pair<int, double> > points;
+        string line;
+        while (std::getline(file, line)) {
+            if (line.empty() || line[0] == '#') { continue; }
+            std::istringstream iss(line);
+            int distance; double t;
+            if (iss >> distance >> t && distance >= 0) { points.emplace_back(distance, t); }
+        }
+        return new TableSeek(points);
+    }
+    cerr << "Error: Unknown seek model " << spec << "." << endl;
+    return nullptr;
+}
+
+SeekModel* seek_model = nullptr;
+
+class Scheduler;
+
+// requests only merge within their stream, so one tenant's I/O is never charged to another
+struct MergeKey {
+    int stream;
+    int track;
+    int sector;
+    bool operator==(const MergeKey& o) const { return stream == o.stream && track == o.track && sector == o.sector; }
+};
+
+struct MergeKeyHash {
+    size_t operator()(const MergeKey& k) const {
+        unsigned long long h = (static_cast<unsigned long long>(static_cast<unsigned int>(k.track)) << 32) | static_cast<unsigned int>(k.sector);
+        return std::hash<unsigned long long>()(h ^ static_cast<unsigned long long>(k.stream) * 0x9E3779B97F4A7C15ULL);
+    }
+};
+
+typedef unordered_map<MergeKey, int, MergeKeyHash> MergeIndex;
+
+// One spindle: its own head, clock, queue and requests. Devices share nothing, so each one
+// can be simulated on its own thread.
+struct Device {
+    int id = 0;
+    vector<IORequest> io_requests;
+    vector<size_t> input_index;   // io_requests[i] is line input_index[i] of the input file
+    Scheduler* sch = nullptr;
+    int current_track = 0;
+    int processing_io = -1;
+    int simulation_time = 0;
+    int busy_until = 0;           // completion time of processing_io
+
+    // request merging (-M): queued, not yet dispatched requests by (stream, track, first sector)
+    // and by (stream, track, sector after the last); requests without a sector range use sector -1
+    MergeIndex merge_front;
+    MergeIndex merge_back;
+    size_t merged_requests = 0;
+    vector<int> dispatch_order;   // requests in the order the scheduler handed them out (replay mode)
+    vector<int> arrival_batch;    // requests arriving at the same tick, handed over in one add_batch
+    size_t next_input = 0;        // first request that has not arrived yet
+    vector<int> device_queue;     // requests handed to the drive (NCQ model)
+    bool finished = false;
+
+    // schedulers rank candidates by distance; the seek model only prices the chosen seek, since
+    // its ceil() makes different distances cost the same
+    int distance(int track) const { return std::abs(track - current_track); }
+    int seek_cost(int track) const { return seek_model->seek_time(distance(track)); }
+};
+
+/*
+    Queue containers take their nodes from the scheduler's own pool instead of one global new per
+    insert. add_batch() receives every request that arrives at the same time in one call, in
+    arrival order. Schedulers override it to insert the burst at once instead of one by one.
+*/
 class Scheduler {
+protected:
+    std::pmr::unsynchronized_pool_resource pool;
+
 public:
-    list<int> ioQ;
+    std::pmr::list<int> ioQ{&pool};
 
-    Scheduler() {}
+    Scheduler(Device& dev) : dev(dev) {}
 
     virtual ~Scheduler() {}
 
     virtual void add(int io_task_id) {
-        log("base class `add` method called. IO index: " + to_string(io_task_id) + ".");
+        LOG("base class `add` method called. IO index: " + to_string(io_task_id) + ".");
         ioQ.push_back(io_task_id);
     }
 
+    virtual void add_batch(const int* io_task_ids, size_t count) {
+        for (size_t i = 0; i < count; ++i) { add(io_task_ids[i]); }
+    }
+
     virtual int get_next() {
-        log("base class `get_next` method called.");
+        LOG("base class `get_next` method called.");
         if (ioQ.empty()) {
-            log("base class: No IO requests available in the queue.");
+            LOG("base class: No IO requests available in the queue.");
             return -1;
         }
         int get_next_io = ioQ.front();
-        log("base class selected IO request " + to_string(get_next_io) + ".");
+        LOG("base class selected IO request " + to_string(get_next_io) + ".");
         ioQ.pop_front();
         return get_next_io;
     }
 
     virtual bool is_free() {
         bool empty = ioQ.empty();
-        log("base class `is_free` method called. Queue is " + string(empty ? "empty" : "not empty") + ".");
+        LOG("base class `is_free` method called. Queue is " + string(empty ? "empty" : "not empty") + ".");
         return empty;
     }
-};
 
+    // queues and sweep state for checkpoints (-C); load() runs on a freshly made scheduler
+    virtual void save(Snapshot& snap) const { put_queue(snap, ioQ); }
+    virtual void load(Snapshot& snap) { get_queue(snap, ioQ); }
 
-Scheduler* sch = nullptr;
-vector<IORequest> io_requests;
-int processing_io = -1;
-int simulation_time = 0;
+protected:
+    Device& dev;
+
+    template <class C> static void put_queue(Snapshot& snap, const C& c) {
+        snap.put_vector(vector<typename C::value_type>(c.begin(), c.end()));
+    }
+    template <class C> static void get_queue(Snapshot& snap, C& c) {
+        vector<typename C::value_type> v;
+        snap.get_vector(v);
+        c.clear();
+        for (const auto& x : v) { c.insert(c.end(), x); }
+    }
+};
 
 
 class FIFOSched : public Scheduler {
 public:
-    FIFOSched() = default;
+    FIFOSched(Device& dev) : Scheduler(dev) {}
     ~FIFOSched() override = default;
 
     void add(int io_task_id) override { 
-        log("adding IO request to the queue.");
+        LOG("adding IO request to the queue.");
         ioQ.push(io_task_id); 
     }
 
+    void add_batch(const int* io_task_ids, size_t count) override {
+        LOG("adding " + to_string(count) + " IO requests to the queue.");
+        for (size_t i = 0; i < count; ++i) { ioQ.push(io_task_ids[i]); }
+    }
+
     int get_next() override {
         if (ioQ.empty()) {  return -1;  }
 
         int get_next_io = ioQ.front();
-        log("selected IO request " + to_string(get_next_io) +
-            " at track " + to_string(io_requests[get_next_io].track) + "."); 
+        LOG("selected IO request " + to_string(get_next_io) +
+            " at track " + to_string(dev.io_requests[get_next_io].track) + "."); 
         ioQ.pop();
-        log("removed IO request  from the queue.");                
+        LOG("removed IO request  from the queue.");                
         return get_next_io;
     }
 
     bool is_free() override { 
-        log("cecking if FIFOSched scheduler is empty.");
+        LOG("cecking if FIFOSched scheduler is empty.");
         return ioQ.empty(); 
     }
 
+    void save(Snapshot& snap) const override {
+        vector<int> ids;
+        for (auto copy = ioQ; !copy.empty(); copy.pop()) { ids.push_back(copy.front()); }
+        snap.put_vector(ids);
+    }
+    void load(Snapshot& snap) override {
+        vector<int> ids;
+        snap.get_vector(ids);
+        for (int id : ids) { ioQ.push(id); }
+    }
+
 private:
-    queue<int> ioQ; 
+    queue<int, std::pmr::deque<int> > ioQ{std::pmr::polymorphic_allocator<int>(&pool)}; 
 };
 
 
 class SSTFSched : public Scheduler {
 public:
-    SSTFSched() = default;
+    SSTFSched(Device& dev) : Scheduler(dev) {}
     ~SSTFSched() override = default;
 
     void add(int io_task_id) override {
-        log("adding IO request " + to_string(io_task_id) +
-            " to the queue with track " + to_string(io_requests[io_task_id].track) + ".");
+        LOG("adding IO request " + to_string(io_task_id) +
+            " to the queue with track " + to_string(dev.io_requests[io_task_id].track) + ".");
         ioQ.insert(io_task_id);
     } 
 
+    // ids only grow, so the range insert appends at the end hint without searching
+    void add_batch(const int* io_task_ids, size_t count) override {
+        LOG("adding " + to_string(count) + " IO requests to the queue.");
+        ioQ.insert(io_task_ids, io_task_ids + count);
+    }
+
     int get_next() override {
         if (ioQ.empty()) {
-            log("no IO requests available in the queue.");
+            LOG("no IO requests available in the queue.");
             return -1;
         }
 
         auto closest_it = get_nearest_request();
         int chosen_request = *closest_it;
-        log("selected IO request " + std::to_string(chosen_request) +
-            " at track " + std::to_string(io_requests[chosen_request].track) + ".");
+        LOG("selected IO request " + std::to_string(chosen_request) +
+            " at track " + std::to_string(dev.io_requests[chosen_request].track) + ".");
 
         remove_request(closest_it); 
         return chosen_request;
     }
 
     bool is_free() override {
-        log("checking if SSTFSched scheduler is empty.");
+        LOG("checking if SSTFSched scheduler is empty.");
         return ioQ.empty();
     }
 
+    void save(Snapshot& snap) const override { put_queue(snap, ioQ); }
+    void load(Snapshot& snap) override { get_queue(snap, ioQ); }
+
 private:
-    std::set<int> ioQ;
-    std::set<int>::iterator get_nearest_request() {
+    std::pmr::set<int> ioQ{&pool};
+    std::pmr::set<int>::iterator get_nearest_request() {
         return std::min_element(
             ioQ.begin(),
             ioQ.end(),
@@ -156,18 +370,18 @@ private:
     }
 
     int track_distance(int io_task_id) const {
-        const int track_position = io_requests[io_task_id].track;
-        int distance = std::abs(track_position - current_track);
-        log("measured the distance between the current position and the target.");
+        const int track_position = dev.io_requests[io_task_id].track;
+        int distance = dev.distance(track_position);
+        LOG("measured the distance between the current position and the target.");
         return distance;
     }
 
-    void remove_request(std::set<int>::iterator it) {
+    void remove_request(std::pmr::set<int>::iterator it) {
         if (it != ioQ.end()) {
-            log("removing IO request " + std::to_string(*it) + " from the queue.");
+            LOG("removing IO request " + std::to_string(*it) + " from the queue.");
             ioQ.erase(it);
         } else {
-            log("attempted to remove an IO request, but it was not found in the queue.");
+            LOG("attempted to remove an IO request, but it was not found in the queue.");
         }
     }
 };
@@ -175,27 +389,32 @@ private:
 
 class LOOKSched : public Scheduler {
 public:
-    LOOKSched() : dir(1) {}
+    LOOKSched(Device& dev) : Scheduler(dev), dir(1) {}
     ~LOOKSched() override = default;
 
     void add(int io_task_id) override {
-        log("adding IO request " + std::to_string(io_task_id) + " to the queue.");
+        LOG("adding IO request " + std::to_string(io_task_id) + " to the queue.");
         ioQ.push_back(io_task_id);
     }
 
+    void add_batch(const int* io_task_ids, size_t count) override {
+        LOG("adding " + std::to_string(count) + " IO requests to the queue.");
+        ioQ.insert(ioQ.end(), io_task_ids, io_task_ids + count);
+    }
+
     int get_next() override {
-        if (ioQ.empty()) { log("no IO requests available in the queue."); return -1; }
+        if (ioQ.empty()) { LOG("no IO requests available in the queue."); return -1; }
 
         int chosen_request = get_nearest_request();
         if (chosen_request == -1) {
-            log("no valid requests in the current dir. Reversing dir.");
+            LOG("no valid requests in the current dir. Reversing dir.");
             reverse_dir(); 
             chosen_request = get_nearest_request();
         }
 
         if (chosen_request != -1) {
-            log("selected IO request " + std::to_string(chosen_request) +
-                " at track " + std::to_string(io_requests[chosen_request].track) + ".");
+            LOG("selected IO request " + std::to_string(chosen_request) +
+                " at track " + std::to_string(dev.io_requests[chosen_request].track) + ".");
             auto it = std::find(ioQ.begin(), ioQ.end(), chosen_request); 
             if (it != ioQ.end()) {
                 ioQ.erase(it); 
@@ -205,26 +424,29 @@ public:
     }
 
     bool is_free() override {
-        log("checking if LOOK scheduler is empty.");
+        LOG("checking if LOOK scheduler is empty.");
         return ioQ.empty();
     }
 
+    void save(Snapshot& snap) const override { put_queue(snap, ioQ); snap.put(dir); }
+    void load(Snapshot& snap) override { get_queue(snap, ioQ); snap.get(dir); }
+
 private:
-    std::deque<int> ioQ; 
+    std::pmr::deque<int> ioQ{&pool}; 
     int dir;          
 
  int get_nearest_request() const {
-    log("finding the closest IO request in the current dir.");
+    LOG("finding the closest IO request in the current dir.");
     int chosen_request = -1;
     int min_distance = std::numeric_limits<int>::max();
 
     for (int io : ioQ) {
-        int track = io_requests[io].track;
-        bool is_valid_dir = (dir == 1 && track >= current_track) || 
-                                  (dir == -1 && track <= current_track);
+        int track = dev.io_requests[io].track;
+        bool is_valid_dir = (dir == 1 && track >= dev.current_track) || 
+                                  (dir == -1 && track <= dev.current_track);
 
         if (is_valid_dir) {
-            int distance = std::abs(track - current_track);
+            int distance = dev.distance(track);
             if (distance < min_distance) {
                 min_distance = distance;
                 chosen_request = io;
@@ -232,10 +454,10 @@ private:
         }
     }
     if (chosen_request == -1) {
-        log("no valid IO requests found in the current dir.");
+        LOG("no valid IO requests found in the current dir.");
     } else {
-        log("closest IO request found at track " +
-            std::to_string(io_requests[chosen_request].track) + ".");
+        LOG("closest IO request found at track " +
+            std::to_string(dev.io_requests[chosen_request].track) + ".");
     }
     return chosen_request;
 }
@@ -246,34 +468,39 @@ void remove_request(int io_task_id) {
 
     if (it != ioQ.end()) {
         ioQ.erase(it);
-        log("io request " + std::to_string(io_task_id) + " removed successfully.");
+        LOG("io request " + std::to_string(io_task_id) + " removed successfully.");
     } 
-    else { log("iO request " + std::to_string(io_task_id) + " not found in the queue."); }
+    else { LOG("iO request " + std::to_string(io_task_id) + " not found in the queue."); }
 }
 
 void reverse_dir() {
     dir = -dir;
-    log("dir reversed. New dir: " + string(dir == 1 ? "upward" : "downward") + ".");
+    LOG("dir reversed. New dir: " + string(dir == 1 ? "upward" : "downward") + ".");
 }
 };
 
 class CLOOKSched : public Scheduler {
 public:
-    CLOOKSched() = default;
+    CLOOKSched(Device& dev) : Scheduler(dev) {}
     ~CLOOKSched() override = default;
 
     void add(int io_task_id) override {
-        log("adding IO request to the queue.");
+        LOG("adding IO request to the queue.");
         ioQ.push_back(io_task_id);
     }
 
+    void add_batch(const int* io_task_ids, size_t count) override {
+        LOG("adding " + to_string(count) + " IO requests to the queue.");
+        ioQ.insert(ioQ.end(), io_task_ids, io_task_ids + count);
+    }
+
 int get_next() override {
-    log("fetching the get_next IO request.");
-    if (ioQ.empty()) { log("no IO requests available in the queue."); return -1;  }
+    LOG("fetching the get_next IO request.");
+    if (ioQ.empty()) { LOG("no IO requests available in the queue."); return -1;  }
 
     auto shortest_distance_it = find_closest_upward();
     if (shortest_distance_it == ioQ.end()) {
-        log("no pending requests ahead. Wrapping around to the lowest track.");
+        LOG("no pending requests ahead. Wrapping around to the lowest track.");
         shortest_distance_it = find_closest_wraparound();
     }
 
@@ -283,21 +510,24 @@ int get_next() override {
 }
 
     bool is_free() override {
-        log("checking if CLOOKSched scheduler is empty.");
+        LOG("checking if CLOOKSched scheduler is empty.");
         return ioQ.empty();
     }
 
+    void save(Snapshot& snap) const override { put_queue(snap, ioQ); }
+    void load(Snapshot& snap) override { get_queue(snap, ioQ); }
+
 private:
-    std::list<int> ioQ; 
-    std::list<int>::iterator find_closest_upward() {
-        log("finding the closest IO request in the upward dir.");
+    std::pmr::list<int> ioQ{&pool}; 
+    std::pmr::list<int>::iterator find_closest_upward() {
+        LOG("finding the closest IO request in the upward dir.");
         auto closest_it = ioQ.end();
         int min_distance = std::numeric_limits<int>::max();
 
         for (auto it = ioQ.begin(); it != ioQ.end(); ++it) {
-            int track = io_requests[*it].track;
-            if (track >= current_track) { 
-                int distance = track - current_track;
+            int track = dev.io_requests[*it].track;
+            if (track >= dev.current_track) { 
+                int distance = dev.distance(track);
                 if (distance < min_distance) {
                     min_distance = distance;
                     closest_it = it;
@@ -306,21 +536,21 @@ private:
         }
 
         if (closest_it == ioQ.end()) {
-            log("no valid upward requests found.");
+            LOG("no valid upward requests found.");
         } else {
-            log("closest upward IO request found at track " + 
-                std::to_string(io_requests[*closest_it].track) + ".");
+            LOG("closest upward IO request found at track " + 
+                std::to_string(dev.io_requests[*closest_it].track) + ".");
         }
         return closest_it;
     }
 
-std::list<int>::iterator find_closest_wraparound() {
-    log("finding the closest IO request by wrapping around to the lowest track.");
+std::pmr::list<int>::iterator find_closest_wraparound() {
+    LOG("finding the closest IO request by wrapping around to the lowest track.");
     return std::min_element(
         ioQ.begin(),
         ioQ.end(),
-        [](int a, int b) {
-            return io_requests[a].track < io_requests[b].track;
+        [this](int a, int b) {
+            return dev.io_requests[a].track < dev.io_requests[b].track;
         }
     );
 }
@@ -329,21 +559,26 @@ std::list<int>::iterator find_closest_wraparound() {
 
 class FLOOKSched : public Scheduler {
 public:
-    FLOOKSched() : dir(1) {} 
+    FLOOKSched(Device& dev) : Scheduler(dev), dir(1) {}
     ~FLOOKSched() override = default;
 
     void add(int io_task_id) override {
-        log("sdding IO request " + to_string(io_task_id) + " to the add queue.");
+        LOG("sdding IO request " + to_string(io_task_id) + " to the add queue.");
         add_queue.push_back(io_task_id);
     }
 
+    void add_batch(const int* io_task_ids, size_t count) override {
+        LOG("adding " + to_string(count) + " IO requests to the add queue.");
+        add_queue.insert(add_queue.end(), io_task_ids, io_task_ids + count);
+    }
+
 int get_next() override {
     if (active_queue.empty() && !add_queue.empty()) {
-        log("active queue is empty. Swapping add queue with active queue.");
+        LOG("active queue is empty. Swapping add queue with active queue.");
         swap_queues();
     }
     if (active_queue.empty()) {
-        log("no IO requests available in the active queue.");
+        LOG("no IO requests available in the active queue.");
         return -1;
     }
     auto shortest_distance_it = get_nearest_request();
@@ -353,24 +588,27 @@ int get_next() override {
     }
 
     int chosen_request = *shortest_distance_it;
-    log("selected IO request " + to_string(chosen_request) + 
-            " at track " + to_string(io_requests[chosen_request].track) + ".");
+    LOG("selected IO request " + to_string(chosen_request) + 
+            " at track " + to_string(dev.io_requests[chosen_request].track) + ".");
     active_queue.erase(shortest_distance_it);
     return chosen_request;
 }
 
     bool is_free() override {
-        log("checking if FLOOKSched scheduler is empty.");
+        LOG("checking if FLOOKSched scheduler is empty.");
         return active_queue.empty() && add_queue.empty();
     }
 
+    void save(Snapshot& snap) const override { put_queue(snap, active_queue); put_queue(snap, add_queue); snap.put(dir); }
+    void load(Snapshot& snap) override { get_queue(snap, active_queue); get_queue(snap, add_queue); snap.get(dir); }
+
 private:
-    list<int> active_queue;
-    list<int> add_queue;
+    std::pmr::list<int> active_queue{&pool};
+    std::pmr::list<int> add_queue{&pool};
     int dir; 
 
     void swap_queues() {
-        log("swapping add queue with active queue and resetting dir to upward.");
+        LOG("swapping add queue with active queue and resetting dir to upward.");
         active_queue.swap(add_queue);
         dir = 1; 
     }
@@ -379,20 +617,20 @@ private:
         dir = -dir;
     }
 
-list<int>::iterator get_nearest_request() {
-    log("finding the closest IO request in the current dir.");
+std::pmr::list<int>::iterator get_nearest_request() {
+    LOG("finding the closest IO request in the current dir.");
     
     if (active_queue.empty()) {
-        log("active queue is empty. No requests to process.");
+        LOG("active queue is empty. No requests to process.");
         return active_queue.end();
     }
 
-    auto compute_closest_request = [&](list<int>::iterator &current_closest, 
+    auto compute_closest_request = [&](std::pmr::list<int>::iterator &current_closest, 
                                        int &min_distance, 
-                                       list<int>::iterator &it) {
-        int track = io_requests[*it].track;
+                                       std::pmr::list<int>::iterator &it) {
+        int track = dev.io_requests[*it].track;
         if (is_valid_track(track)) {
-            int distance = abs(track - current_track); 
+            int distance = dev.distance(track); 
             if (distance < min_distance) {
                 min_distance = distance;
                 current_closest = it;
@@ -408,36 +646,496 @@ list<int>::iterator get_nearest_request() {
     }
 
     if (closest_it == active_queue.end()) {
-        log("no valid requests found in the current dir.");
+        LOG("no valid requests found in the current dir.");
     }
     return closest_it;
 }
 
 bool is_valid_track(int track) const {
-    return (dir > 0 && track >= current_track) || 
-           (dir < 0 && track <= current_track);
+    return (dir > 0 && track >= dev.current_track) || 
+           (dir < 0 && track <= dev.current_track);
 }
 
 };
 
+
+/*
+    mq-deadline style: requests are served in ascending track order (C-LOOK over a sorted index),
+    in batches of FIFO_BATCH. Before each batch the oldest request is checked. If it has expired,
+    up to EXPIRED_BATCH expired requests are served oldest first, and then the sweep resumes where
+    it left off. Expiries can never take over dispatch.
+    With -e<n> or -c D:<n> a request expires after n time units. By default (deadline_expire 0) it
+    expires once it has waited EXPIRE_STROKES full-stroke seeks and EXPIRE_AGE times the mean age
+    of the queue. A C-LOOK cycle takes about two strokes of seeking, so ordinary sweep waits do not
+    expire under any seek model. A burst ages the whole queue together, so it does not expire
+    either. What expires is a request left behind while the sweep crawls through a dense stream.
+    Both indexes are ordered sets, so add and get_next are O(log n).
+*/
+int deadline_expire = 0;
+
+class DeadlineSched : public Scheduler {
+public:
+    DeadlineSched(Device& dev, int expire = deadline_expire) : Scheduler(dev), expire(expire) {}
+    ~DeadlineSched() override = default;
+
+    void add(int io_task_id) override {
+        const IORequest& io = dev.io_requests[io_task_id];
+        LOG("adding IO request " + to_string(io_task_id) + " with track " + to_string(io.track) + ".");
+        sorted.insert(make_pair(io.track, io_task_id));
+        fifo.insert(make_pair(io.arrival_time, io_task_id));
+        arrival_sum += io.arrival_time;
+        max_track = std::max(max_track, io.track);
+    }
+
+    // sort the burst by track once, then each insert lands right after the previous one
+    void add_batch(const int* io_task_ids, size_t count) override {
+        LOG("adding " + to_string(count) + " IO requests.");
+        batch.clear();
+        for (size_t i = 0; i < count; ++i) {
+            const IORequest& io = dev.io_requests[io_task_ids[i]];
+            batch.push_back(make_pair(io.track, io_task_ids[i]));
+            fifo.insert(fifo.end(), make_pair(io.arrival_time, io_task_ids[i]));
+            arrival_sum += io.arrival_time;
+            max_track = std::max(max_track, io.track);
+        }
+        std::sort(batch.begin(), batch.end());
+        auto hint = sorted.end();
+        for (const pair<int, int>& p : batch) {
+            if (hint != sorted.end() && !(p < *hint)) { hint = sorted.lower_bound(p); }
+            hint = std::next(sorted.insert(hint, p));
+        }
+    }
+
+    int get_next() override {
+        if (sorted.empty()) { LOG("no IO requests available in the queue."); return -1; }
+
+        if (batch_left == 0) { batch_left = FIFO_BATCH; expired_left = EXPIRED_BATCH; }
+        auto it = sorted.end();
+        const pair<int, int>& oldest = *fifo.begin();
+        if (expired_left > 0 && dev.simulation_time - oldest.first >= expiry()) {
+            LOG("IO request " + to_string(oldest.second) + " expired. Serving it ahead of the sweep.");
+            if (resume_track < 0) { resume_track = dev.current_track; }
+            expired_left--;
+            it = sorted.find(make_pair(dev.io_requests[oldest.second].track, oldest.second));
+        } else {
+            expired_left = 0;
+            batch_left--;
+            it = sorted.lower_bound(make_pair(resume_track >= 0 ? resume_track : dev.current_track, -1));
+            resume_track = -1;
+            if (it == sorted.end()) {
+                LOG("no pending requests ahead. Wrapping around to the lowest track.");
+                it = sorted.begin();
+            }
+        }
+
+        int chosen_request = it->second;
+        sorted.erase(it);
+        fifo.erase(make_pair(dev.io_requests[chosen_request].arrival_time, chosen_request));
+        arrival_sum -= dev.io_requests[chosen_request].arrival_time;
+        LOG("selected IO request " + to_string(chosen_request) +
+            " at track " + to_string(dev.io_requests[chosen_request].track) + ".");
+        return chosen_request;
+    }
+
+    bool is_free() override {
+        LOG("checking if DeadlineSched scheduler is empty.");
+        return sorted.empty();
+    }
+
+    void save(Snapshot& snap) const override {
+        put_queue(snap, sorted); put_queue(snap, fifo);
+        snap.put(batch_left); snap.put(expired_left); snap.put(resume_track); snap.put(max_track); snap.put(arrival_sum);
+    }
+    void load(Snapshot& snap) override {
+        get_queue(snap, sorted); get_queue(snap, fifo);
+        snap.get(batch_left); snap.get(expired_left); snap.get(resume_track); snap.get(max_track); snap.get(arrival_sum);
+    }
+
+private:
+    static const int FIFO_BATCH = 16;
+    static const int EXPIRED_BATCH = 4;
+    static const int EXPIRE_STROKES = 6;
+    static const int EXPIRE_AGE = 4;
+    const int expire;
+    std::pmr::set<pair<int, int> > sorted{&pool};   // (track, id)
+    std::pmr::set<pair<int, int> > fifo{&pool};     // (arrival, id)
+    vector<pair<int, int> > batch;
+    int batch_left = 0;
+    int expired_left = 0;         // expired requests still allowed before the sweep resumes
+    int resume_track = -1;        // where the sweep left off for the expired requests, -1 if it did not
+    int max_track = 0;            // the farthest track seen, for the full-stroke seek
+    long long arrival_sum = 0;    // over the queue, for its mean age
+
+    double expiry() const {
+        if (expire > 0) { return expire; }
+        double mean_age = dev.simulation_time - static_cast<double>(arrival_sum) / fifo.size();
+        return std::max(EXPIRE_STROKES * static_cast<double>(seek_model->seek_time(max_track)), EXPIRE_AGE * mean_age);
+    }
+};
+
+
+/*
+    BFQ-like budget fair queueing. Every stream (the input's stream column) has its own track-sorted
+    queue, and all of them are served in one C-LOOK sweep. A request is charged to its own stream
+    when it is dispatched: seek time + 1, and 1 more for every request merged into it. The virtual
+    time is the least any backlogged stream has been charged, and a stream that goes busy starts
+    from it, so idling earns no credit. A stream more than the budget ahead of the virtual time
+    sits out the sweep until the others catch up. While every stream takes its share this is plain
+    C-LOOK; a stream that asks for more is held back instead of pushing up everyone's wait.
+    The budget is -b<n> or -c B:<n>, by default (bfq_budget 0) BUDGET_STROKES full-stroke seeks.
+    Picking a request is O(log n) per backlogged stream.
+*/
+int bfq_budget = 0;
+
+class BFQSched : public Scheduler {
+public:
+    BFQSched(Device& dev, int budget = bfq_budget) : Scheduler(dev), budget(budget) {}
+    ~BFQSched() override = default;
+
+    void add(int io_task_id) override {
+        int stream = dev.io_requests[io_task_id].stream;
+        LOG("adding IO request " + to_string(io_task_id) + " to stream " + to_string(stream) + ".");
+        Stream& s = streams[slot_of(stream)];
+        if (s.queue.empty()) { s.used = std::max(s.used, virtual_time); }
+        s.queue.insert(make_pair(dev.io_requests[io_task_id].track, io_task_id));
+        max_track = std::max(max_track, dev.io_requests[io_task_id].track);
+        pending++;
+    }
+
+    void add_batch(const int* io_task_ids, size_t count) override {
+        LOG("adding " + to_string(count) + " IO requests.");
+        for (size_t i = 0; i < count; ++i) {
+            const IORequest& io = dev.io_requests[io_task_ids[i]];
+            Stream& s = streams[slot_of(io.stream)];
+            if (s.queue.empty()) { s.used = std::max(s.used, virtual_time); }
+            s.queue.insert(make_pair(io.track, io_task_ids[i]));
+            max_track = std::max(max_track, io.track);
+        }
+        pending += count;
+    }
+
+    int get_next() override {
+        if (pending == 0) { LOG("no IO requests available in the queue."); return -1; }
+
+        advance_virtual_time();
+        Stream& s = streams[next_stream()];
+        auto it = s.queue.lower_bound(make_pair(dev.current_track, -1));
+        if (it == s.queue.end()) { it = s.queue.begin(); }
+        int chosen_request = it->second;
+        s.used += dev.seek_cost(it->first) + 1;
+        for (int m = dev.io_requests[chosen_request].next_merged; m != -1; m = dev.io_requests[m].next_merged) { s.used++; }
+        s.queue.erase(it);
+        pending--;
+        LOG("selected IO request " + to_string(chosen_request) + " from stream " + to_string(s.id) + ".");
+        return chosen_request;
+    }
+
+    bool is_free() override {
+        LOG("checking if BFQSched scheduler is empty.");
+        return pending == 0;
+    }
+
+    void save(Snapshot& snap) const override {
+        snap.put((unsigned long long)streams.size());
+        for (const Stream& s : streams) {
+            put_queue(snap, s.queue);
+            snap.put(s.id); snap.put(s.used);
+        }
+        snap.put(virtual_time); snap.put(max_track); snap.put(pending);
+    }
+    void load(Snapshot& snap) override {
+        streams.clear();
+        slots.clear();
+        for (unsigned long long n = snap.get<unsigned long long>(); n > 0; n--) {
+            streams.emplace_back(&pool);
+            Stream& s = streams.back();
+            get_queue(snap, s.queue);
+            snap.get(s.id); snap.get(s.used);
+            slots[s.id] = static_cast<int>(streams.size()) - 1;
+        }
+        snap.get(virtual_time); snap.get(max_track); snap.get(pending);
+    }
+
+private:
+    struct Stream {
+        explicit Stream(std::pmr::memory_resource* mr) : queue(mr) {}
+        std::pmr::set<pair<int, int> > queue;   // (track, id)
+        int id = 0;                   // stream id from the input
+        long long used = 0;           // service charged so far
+    };
+    static const int BUDGET_STROKES = 4;
+    const int budget;
+    vector<Stream> streams;                 // in order of first appearance
+    unordered_map<int, int> slots;          // stream id -> index in streams
+    long long virtual_time = 0;
+    int max_track = 0;                      // the farthest track seen, for the full-stroke seek
+    size_t pending = 0;
+
+    // stream ids in the input can be anything, so streams are kept densely and found by id
+    int slot_of(int stream) {
+        auto it = slots.find(stream);
+        if (it != slots.end()) { return it->second; }
+        streams.emplace_back(&pool);
+        streams.back().id = stream;
+        slots.emplace(stream, static_cast<int>(streams.size()) - 1);
+        return static_cast<int>(streams.size()) - 1;
+    }
+
+    long long limit() const { return budget > 0 ? budget : BUDGET_STROKES * static_cast<long long>(seek_model->seek_time(max_track)); }
+
+    void advance_virtual_time() {
+        long long least = std::numeric_limits<long long>::max();
+        for (const Stream& s : streams) {
+            if (!s.queue.empty()) { least = std::min(least, s.used); }
+        }
+        virtual_time = std::max(virtual_time, least);
+    }
+
+    // the stream holding the C-LOOK pick among those within the budget; the least charged always is
+    int next_stream() const {
+        int ahead = -1, lowest = -1;
+        pair<int, int> ahead_key, lowest_key;
+        for (size_t i = 0; i < streams.size(); ++i) {
+            const Stream& s = streams[i];
+            if (s.queue.empty()) { continue; }
+            if (s.used - virtual_time > limit()) { LOG("stream " + to_string(s.id) + " is over its budget. Holding it back."); continue; }
+            auto it = s.queue.lower_bound(make_pair(dev.current_track, -1));
+            if (it != s.queue.end() && (ahead < 0 || *it < ahead_key)) { ahead = static_cast<int>(i); ahead_key = *it; }
+            if (lowest < 0 || *s.queue.begin() < lowest_key) { lowest = static_cast<int>(i); lowest_key = *s.queue.begin(); }
+        }
+        if (ahead < 0 && lowest >= 0) { LOG("no pending requests ahead. Wrapping around to the lowest track."); }
+        return ahead >= 0 ? ahead : lowest;
+    }
+};
+
+/*
+    Adaptive meta-scheduler. One indexed queue (by track and by arrival) is shared by four shadow
+    policies: FIFO, SSTF, LOOK and C-LOOK. On every dispatch each policy names the request its own
+    scheduler would pick, ties included, at O(log n) apiece. The pick is charged a throughput
+    cost, its seek time + 1, and a wait cost, the time units the oldest queued request has waited
+    longer than it. Each policy sums both over the last adapt_window decisions. The best policy
+    has the least wait sum among those whose seek sum is within ADAPT_ENTER_SLACK of the cheapest
+    one's, so wait only decides between policies that keep up with the queue. A policy whose seek
+    sum is over ADAPT_KEEP_SLACK times the cheapest is lagging. FIFO has no wait cost, but under
+    random load it lags and cannot win. The active policy dispatches. It is replaced by the best
+    policy in one of two cases:
+      - it is lagging (FIFO when a sequential phase turns random), at once;
+      - the best policy's wait sum is under ADAPT_SWITCH_RATIO of its own, a full window has
+        passed since the last switch, and the active policy has run for its dwell.
+    Switching back to the policy just replaced takes ADAPT_BACK_SCALE times the ratio. A switch
+    also needs a clock that has moved, since same-track requests take no time and many decisions
+    can fall on one tick. The dwell starts at
+    ADAPT_DWELL windows, doubles on every switch back up to ADAPT_MAX_DWELL windows, and resets
+    on a switch to a third policy, so a workload that keeps flipping settles down. The switches
+    are kept so the summary can show which policy ran when.
+*/
+int adapt_window = 64;
+
+class AdaptiveSched : public Scheduler {
+public:
+    AdaptiveSched(Device& dev, int window = adapt_window)
+        : Scheduler(dev), window(window), recent_seek(POLICIES * window, 0.0), recent_wait(POLICIES * window, 0.0) {}
+    ~AdaptiveSched() override = default;
+
+    static const int POLICIES = 4;
+    static constexpr const char* NAMES = "NSLC";
+    vector<pair<int, int> > switches;    // (simulation time, policy) each time the active policy changed
+    long long decisions[POLICIES] = {0, 0, 0, 0};
+
+    void add(int io_task_id) override {
+        const IORequest& io = dev.io_requests[io_task_id];
+        LOG("adding IO request " + to_string(io_task_id) + " with track " + to_string(io.track) + ".");
+        sorted.insert(make_pair(io.track, io_task_id));
+        fifo.insert(make_pair(io.arrival_time, io_task_id));
+    }
+
+    int get_next() override {
+        if (sorted.empty()) { LOG("no IO requests available in the queue."); return -1; }
+        if (switches.empty()) { switches.push_back(make_pair(dev.simulation_time, active)); }
+
+        int oldest_arrival = fifo.begin()->first;
+        int picks[POLICIES] = { fifo.begin()->second, pick_sstf(), pick_look(), pick_clook() };
+        size_t slot = static_cast<size_t>(step % window);
+        for (int p = 0; p < POLICIES; ++p) {
+            const IORequest& io = dev.io_requests[picks[p]];
+            double seek = dev.seek_cost(io.track) + 1;
+            double wait = io.arrival_time - oldest_arrival;
+            seek_sum[p] += seek - recent_seek[p * window + slot];
+            recent_seek[p * window + slot] = seek;
+            wait_sum[p] += wait - recent_wait[p * window + slot];
+            recent_wait[p * window + slot] = wait;
+        }
+        step++;
+        since_switch++;
+
+        double least_seek = *std::min_element(seek_sum, seek_sum + POLICIES);
+        int best = -1;
+        for (int p = 0; p < POLICIES; ++p) {
+            if (seek_sum[p] <= least_seek * ADAPT_ENTER_SLACK && (best < 0 || wait_sum[p] < wait_sum[best])) { best = p; }
+        }
+        bool lagging = seek_sum[active] > least_seek * ADAPT_KEEP_SLACK;
+        if (best != active && (lagging || since_switch >= window) && dev.simulation_time > switches.back().first) {
+            bool back = best == previous;
+            double limit = wait_sum[active] * (back ? ADAPT_BACK_SCALE : 1.0);
+            if (lagging || (since_switch >= dwell && wait_sum[best] < limit * ADAPT_SWITCH_RATIO)) {
+                LOG(string("switching from ") + NAMES[active] + (lagging ? " (lagging)" : "") + " to " + NAMES[best] + ".");
+                dwell = back ? std::min(dwell * 2, ADAPT_MAX_DWELL * window) : ADAPT_DWELL * window;
+                previous = active;
+                active = best;
+                since_switch = 0;
+                switches.push_back(make_pair(dev.simulation_time, active));
+            }
+        }
+
+        int chosen_request = picks[active];
+        const IORequest& io = dev.io_requests[chosen_request];
+        sorted.erase(make_pair(io.track, chosen_request));
+        fifo.erase(make_pair(io.arrival_time, chosen_request));
+        decisions[active]++;
+        LOG(string("policy ") + NAMES[active] + " selected IO request " + to_string(chosen_request) + ".");
+        return chosen_request;
+    }
+
+    bool is_free() override {
+        LOG("checking if AdaptiveSched scheduler is empty.");
+        return sorted.empty();
+    }
+
+    void save(Snapshot& snap) const override {
+        put_queue(snap, sorted); put_queue(snap, fifo);
+        snap.put_vector(recent_seek); snap.put_vector(recent_wait); snap.put(seek_sum); snap.put(wait_sum);
+        snap.put(step); snap.put(since_switch); snap.put(dwell); snap.put(active); snap.put(previous); snap.put(look_dir);
+        snap.put_vector(switches); snap.put(decisions);
+    }
+    void load(Snapshot& snap) override {
+        get_queue(snap, sorted); get_queue(snap, fifo);
+        snap.get_vector(recent_seek); snap.get_vector(recent_wait); snap.get(seek_sum); snap.get(wait_sum);
+        snap.get(step); snap.get(since_switch); snap.get(dwell); snap.get(active); snap.get(previous); snap.get(look_dir);
+        snap.get_vector(switches); snap.get(decisions);
+    }
+
+private:
+    static constexpr double ADAPT_ENTER_SLACK = 1.1;
+    static constexpr double ADAPT_KEEP_SLACK = 1.5;
+    static constexpr double ADAPT_SWITCH_RATIO = 0.9;
+    static constexpr double ADAPT_BACK_SCALE = 2.0 / 3;
+    static const long long ADAPT_DWELL = 8;         // windows
+    static const long long ADAPT_MAX_DWELL = 64;
+    const int window;
+    std::pmr::set<pair<int, int> > sorted{&pool};   // (track, id)
+    std::pmr::set<pair<int, int> > fifo{&pool};     // (arrival, id)
+    vector<double> recent_seek;        // per policy, the charges of the last window decisions
+    vector<double> recent_wait;
+    double seek_sum[POLICIES] = {0, 0, 0, 0};
+    double wait_sum[POLICIES] = {0, 0, 0, 0};
+    long long step = 0;
+    long long since_switch = 0;
+    long long dwell = ADAPT_DWELL * window;   // decisions the active policy runs before it can be replaced
+    int active = 1;                    // start with SSTF
+    int previous = -1;                 // the policy active before it
+    int look_dir = 1;
+
+    // the oldest request on a track that has some, which is what the list-based schedulers take on a tie
+    int first_on(int track) const { return sorted.lower_bound(make_pair(track, -1))->second; }
+
+    // on equal distance SSTFSched takes the older request, whichever side it is on
+    int pick_sstf() {
+        auto up = sorted.lower_bound(make_pair(dev.current_track, -1));
+        if (up == sorted.begin()) { return up->second; }
+        int down = first_on(std::prev(up)->first);
+        if (up == sorted.end()) { return down; }
+        int up_distance = up->first - dev.current_track;
+        int down_distance = dev.current_track - dev.io_requests[down].track;
+        if (down_distance != up_distance) { return down_distance < up_distance ? down : up->second; }
+        return std::min(down, up->second);
+    }
+
+    // LOOK keeps sweeping in look_dir and reverses when nothing is left ahead, active or not
+    int pick_look() {
+        if (look_dir > 0) {
+            auto up = sorted.lower_bound(make_pair(dev.current_track, -1));
+            if (up != sorted.end()) { return up->second; }
+            look_dir = -1;
+            return first_on(std::prev(sorted.end())->first);
+        }
+        auto down = sorted.upper_bound(make_pair(dev.current_track, std::numeric_limits<int>::max()));
+        if (down != sorted.begin()) { return first_on(std::prev(down)->first); }
+        look_dir = 1;
+        return sorted.begin()->second;
+    }
+
+    int pick_clook() {
+        auto up = sorted.lower_bound(make_pair(dev.current_track, -1));
+        return up != sorted.end() ? up->second : sorted.begin()->second;
+    }
+};
+
 //------------------------------------------------------------------------------------------------------------------------------
 
 bool is_valid_line(const std::string& line) {
     bool valid = !line.empty() && line[0] != '#';
-    if (!valid) { log("ignoring invalid or comment line: " + line); }
+    if (!valid) { LOG("ignoring invalid or comment line: " + line); }
     return valid;
 }
 
-void parse_and_add_io(const std::string& line) {
+vector<Device> devices;
+
+// stream ids in the input can be anything; tenants number them densely in order of first appearance
+vector<int> tenant_stream;             // tenant -> stream id
+unordered_map<int, int> tenant_index;  // stream id -> tenant
+
+int tenant_of(int stream) {
+    auto it = tenant_index.find(stream);
+    if (it != tenant_index.end()) { return it->second; }
+    tenant_index.emplace(stream, static_cast<int>(tenant_stream.size()));
+    tenant_stream.push_back(stream);
+    return static_cast<int>(tenant_stream.size()) - 1;
+}
+
+// the input has no angular position, so spread requests over the track with a fixed hash of their line
+int sector_of(size_t input_index) {
+    unsigned int h = static_cast<unsigned int>(input_index) * 2654435761u;
+    return static_cast<int>((h >> 16) & 0x7fff);
+}
+int num_devices = 1;   // requests without a device column are spread over this many devices by track
+const int MAX_DEVICES = 4096;   // device ids index the device table, so they are bounded
+bool merge_requests = false;   // -M
+bool record_dispatch = false;  // keep each device's dispatch order for replay
+
+void add_io(int arrival_time, int track, int device, int stream, int sector, int size, size_t input_index) {
+    if (device >= static_cast<int>(devices.size())) { devices.resize(device + 1); }
+    devices[device].id = device;
+    devices[device].io_requests.emplace_back(arrival_time, track);
+    IORequest& io = devices[device].io_requests.back();
+    io.stream = stream;
+    io.tenant = tenant_of(stream);
+    io.has_range = sector >= 0;
+    io.sector = io.has_range ? sector : sector_of(input_index);
+    io.size = size;
+    devices[device].input_index.push_back(input_index);
+    LOG("parsed and added IO request: Arrival Time = " + std::to_string(arrival_time) +
+        ", Track = " + std::to_string(track) + ", Device = " + std::to_string(device) + ".");
+}
+
+// false when the line adds no request
+bool parse_and_add_io(const std::string& line, size_t input_index) {
     std::istringstream iss(line);
-    int arrival_time = 0, track = 0;
+    int arrival_time = 0, track = 0, device = -1, stream = 0, sector = -1, size = 1;
     if (iss >> arrival_time >> track) {
-        io_requests.emplace_back(arrival_time, track);
-        log("parsed and added IO request: Arrival Time = " + std::to_string(arrival_time) +
-            ", Track = " + std::to_string(track) + ".");
-    } else {
-        log("failed to parse line: " + line);
+        if (!(iss >> device) || device < 0) { device = track % num_devices; }
+        if (!(iss >> stream) || stream < 0) { stream = 0; }
+        if (!(iss >> sector) || sector < 0) { sector = -1; }
+        if (!(iss >> size) || size <= 0) { size = 1; }
+        if (device >= MAX_DEVICES) {
+            std::cerr << "Warning: device " << device << " is out of range (0.." << MAX_DEVICES - 1 << "); request skipped." << std::endl;
+            LOG("device out of range, line skipped: " + line);
+            return false;
+        }
+        add_io(arrival_time, track, device, stream, sector, size, input_index);
+        return true;
     }
+    LOG("failed to parse line: " + line);
+    return false;
 }
 
 void read_input_file(const std::string& filename) {
@@ -446,234 +1144,1488 @@ void read_input_file(const std::string& filename) {
         return;
     }
 
-    log("started reading input file: " + filename);
-    int line_count = 0; // counter for valid lines processed
+    LOG("started reading input file: " + filename);
+    size_t line_count = 0; // counter for valid lines processed
 
     std::string line;
     while (std::getline(file, line)) { 
         //trim(line);
 
         if (line.empty() || line[0] == '#') {
-            log("skipping comment or empty line.");
+            LOG("skipping comment or empty line.");
             continue;
         }
 
         if (is_valid_line(line)) {
-            parse_and_add_io(line);
-            ++line_count;
+            if (parse_and_add_io(line, line_count)) { ++line_count; }
         } else {
-            log("invalid line skipped: " + line);
+            LOG("invalid line skipped: " + line);
         }
     }
     file.close();
 }
 
-void update_statistics(const IORequest& io, int& total_head_movement, double& total_turnaround_time, double& total_wait_time, int& longest_wait_time) {
+/*
+    Synthetic traces (-g<spec>), generated straight into the devices without touching disk. Keys
+    (see workload.h for the distributions):
+        n=100000        requests
+        seed=1
+        arrival=poisson or bursty, gap=10 (mean time between arrivals), burst=8 (mean burst length)
+        tracks=512, dist=uniform|zipf|seq, s=0.99 (zipf exponent), run=32 (mean sequential run)
+        streams=1       the stream column; every stream draws tracks from its own sampler
+    With -E the trace is printed in the input format instead of simulated.
+*/
+class DiskWorkload {
+public:
+    explicit DiskWorkload(const string& text)
+        : spec(text), rng(static_cast<uint64_t>(spec.get("seed", 1LL))),
+          arrivals(spec.get("arrival", string("poisson")), spec.get("gap", 10.0), spec.get("burst", 8.0)) {
+        remaining = spec.get("n", 100000LL);
+        long long tracks = spec.get("tracks", 512LL);
+        long long streams = spec.get("streams", 1LL);
+        string dist = spec.get("dist", string("uniform"));
+        double s = spec.get("s", 0.99), run = spec.get("run", 32.0);
+        spec.check();
+        if (remaining < 0 || tracks <= 0 || streams <= 0) { cerr << "Error: Workload n, tracks and streams must be positive." << endl; exit(1); }
+        for (long long i = 0; i < streams; ++i) { samplers.emplace_back(dist, tracks, s, run, rng); }
+    }
+
+    bool next(int& arrival_time, int& track, int& stream) {
+        if (remaining-- <= 0) { return false; }
+        long long t = arrivals.next(rng);
+        if (t > std::numeric_limits<int>::max()) { cerr << "Error: Workload runs past the simulator's time range." << endl; exit(1); }
+        arrival_time = static_cast<int>(t);
+        stream = samplers.size() > 1 ? static_cast<int>(rng.below(samplers.size())) : 0;
+        track = static_cast<int>(samplers[stream].sample(rng));
+        return true;
+    }
+
+    bool multi_stream() const { return samplers.size() > 1; }
+
+private:
+    WorkloadSpec spec;
+    WorkloadRng rng;
+    ArrivalProcess arrivals;
+    vector<LocationSampler> samplers;
+    long long remaining = 0;
+};
+
+void generate_input(const string& spec) {
+    DiskWorkload workload(spec);
+    int arrival_time, track, stream;
+    for (size_t i = 0; workload.next(arrival_time, track, stream); ++i) {
+        add_io(arrival_time, track, track % num_devices, stream, -1, 1, i);
+    }
+}
+
+// -E: stream the trace to stdout in the input format
+void emit_workload(const string& spec) {
+    DiskWorkload workload(spec);
+    static char buf[1 << 16];
+    size_t used = 0;
+    auto put_int = [&used](int v) {
+        char digits[12];
+        int n = 0;
+        do { digits[n++] = static_cast<char>('0' + v % 10); v /= 10; } while (v > 0);
+        while (n > 0) { buf[used++] = digits[--n]; }
+    };
+    int arrival_time, track, stream;
+    while (workload.next(arrival_time, track, stream)) {
+        if (used > sizeof(buf) - 64) { fwrite(buf, 1, used, stdout); used = 0; }
+        put_int(arrival_time); buf[used++] = ' '; put_int(track);
+        if (workload.multi_stream()) { std::memcpy(buf + used, " -1 ", 4); used += 4; put_int(stream); }
+        buf[used++] = '\n';
+    }
+    fwrite(buf, 1, used, stdout);
+}
+
+/*
+    Log-linear (HDR-style) histogram: values below 2*SUB_BUCKETS are exact, every power of two
+    above that is split into SUB_BUCKETS buckets, so percentiles are within ~3% of the true value
+    in constant memory regardless of how many requests are recorded.
+*/
+class LatencyHistogram {
+public:
+    void record(long long v) {
+        if (v < 0) { v = 0; }
+        buckets[bucket_of(v)]++;
+        count++;
+        max_value = std::max(max_value, v);
+    }
+
+    void merge(const LatencyHistogram& other) {
+        for (int b = 0; b < NUM_BUCKETS; ++b) { buckets[b] += other.buckets[b]; }
+        count += other.count;
+        max_value = std::max(max_value, other.max_value);
+    }
+
+    // highest value equivalent to the bucket holding the p-th percentile, capped at the true max
+    long long percentile(double p) const {
+        if (count == 0) { return 0; }
+        unsigned long long rank = static_cast<unsigned long long>(std::ceil(p / 100.0 * count));
+        rank = std::max(1ULL, std::min(rank, count));
+        unsigned long long seen = 0;
+        for (int b = 0; b < NUM_BUCKETS; ++b) {
+            seen += buckets[b];
+            if (seen >= rank) { return std::min(bucket_high(b), max_value); }
+        }
+        return max_value;
+    }
+
+    void dump(FILE* out, const string& label) const {
+        for (int b = 0; b < NUM_BUCKETS; ++b) {
+            if (buckets[b] == 0) { continue; }
+            std::fprintf(out, "%s,%lld,%lld,%llu\n", label.c_str(), bucket_low(b), bucket_high(b), buckets[b]);
+        }
+    }
+
+private:
+    static const int SUB_BITS = 5;
+    static const int SUB_BUCKETS = 1 << SUB_BITS;
+    static const int NUM_BUCKETS = (64 - SUB_BITS) * SUB_BUCKETS;
+    unsigned long long buckets[NUM_BUCKETS] = {};
+    unsigned long long count = 0;
+    long long max_value = 0;
+
+    static int bucket_of(long long v) {
+        if (v < 2 * SUB_BUCKETS) { return static_cast<int>(v); }
+        int e = 63 - __builtin_clzll(v) - SUB_BITS;
+        return e * SUB_BUCKETS + static_cast<int>(v >> e);
+    }
+    static long long bucket_low(int b) {
+        if (b < 2 * SUB_BUCKETS) { return b; }
+        int e = b / SUB_BUCKETS - 1;
+        return static_cast<long long>(b % SUB_BUCKETS + SUB_BUCKETS) << e;
+    }
+    static long long bucket_high(int b) {
+        if (b < 2 * SUB_BUCKETS) { return b; }
+        return bucket_low(b) + (1LL << (b / SUB_BUCKETS - 1)) - 1;
+    }
+};
+
+bool print_percentiles = false;   // -P: PCT lines after each SUM line
+string histogram_file;            // -H: wait/turnaround histograms as CSV
+bool tenant_report = false;       // -T: TENANT lines and the FAIRNESS line
+
+struct IOStats {
+    size_t requests = 0;
+    long long total_head_movement = 0;
+    long long busy_time = 0;          // time spent between start and finish of requests
+    double total_turnaround_time = 0.0;
+    double total_wait_time = 0.0;
+    int longest_wait_time = 0;
+    LatencyHistogram wait_hist;
+    LatencyHistogram turnaround_hist;
+
+    void merge(const IOStats& other) {
+        requests += other.requests;
+        total_head_movement += other.total_head_movement;
+        busy_time += other.busy_time;
+        total_turnaround_time += other.total_turnaround_time;
+        total_wait_time += other.total_wait_time;
+        longest_wait_time = std::max(longest_wait_time, other.longest_wait_time);
+        wait_hist.merge(other.wait_hist);
+        turnaround_hist.merge(other.turnaround_hist);
+    }
+};
+
+void update_statistics(const IORequest& io, IOStats& stats) {
     int wait_time = io.start_time - io.arrival_time;
-    int head_movement = io.finish_time - io.start_time;
+    int head_movement = io.movement;
     int process_duration = io.finish_time - io.arrival_time;
     
-    log("calculated statistics for IO request: wait_time = " + std::to_string(wait_time) +
+    LOG("calculated statistics for IO request: wait_time = " + std::to_string(wait_time) +
         ", head_movement = " + std::to_string(head_movement) +
         ", process_duration = " + std::to_string(process_duration) + ".");
 
-    total_head_movement += head_movement;
-    total_turnaround_time += static_cast<double>(process_duration);
-    total_wait_time += static_cast<double>(wait_time);
-    longest_wait_time = std::max(longest_wait_time, wait_time);
-    log("updated statistics for IO request: movement = " + std::to_string(head_movement) +
+    stats.requests++;
+    stats.total_head_movement += head_movement;
+    if (io.merged_into < 0) { stats.busy_time += io.finish_time - io.start_time; }
+    stats.total_turnaround_time += static_cast<double>(process_duration);
+    stats.total_wait_time += static_cast<double>(wait_time);
+    stats.longest_wait_time = std::max(stats.longest_wait_time, wait_time);
+    stats.wait_hist.record(wait_time);
+    stats.turnaround_hist.record(process_duration);
+    LOG("updated statistics for IO request: movement = " + std::to_string(head_movement) +
         ", turnaround time = " + std::to_string(process_duration) +
         ", wait time = " + std::to_string(wait_time) + ".");
 }
 
 
 void print_io_request(size_t index, const IORequest& io) {
-    log("printing IO request details: Index = " + std::to_string(index) +
+    LOG("printing IO request details: Index = " + std::to_string(index) +
         ", Arrival = " + std::to_string(io.arrival_time) +
         ", Start = " + std::to_string(io.start_time) +
         ", Completion = " + std::to_string(io.finish_time) + ".");
-    std::printf("%5zu: %5d %5d %5d\n", index, io.arrival_time, io.start_time, io.finish_time);
+    if (io.measured_ns >= 0) {
+        std::printf("%5zu: %5d %5d %5d %10.1f\n", index, io.arrival_time, io.start_time, io.finish_time, io.measured_ns / 1000.0);
+    } else {
+        std::printf("%5zu: %5d %5d %5d\n", index, io.arrival_time, io.start_time, io.finish_time);
+    }
 }
 
 
-void print_io_details(int& total_head_movement, double& total_turnaround_time, double& total_wait_time, int& longest_wait_time) {
-    log("printing details of all IO requests.");
-    for (size_t i = 0; i < io_requests.size(); ++i) {
-        const IORequest& io = io_requests.at(i);
+void print_io_details(vector<pair<const Device*, size_t> >& by_input) {
+    LOG("printing details of all IO requests.");
+    for (size_t i = 0; i < by_input.size(); ++i) {
+        const IORequest& io = by_input[i].first->io_requests.at(by_input[i].second);
         print_io_request(i, io); 
-        update_statistics(io, total_head_movement, total_turnaround_time, total_wait_time, longest_wait_time);
     }
 }
 
-void print_summary_stats(int total_head_movement, double total_turnaround_time, double total_wait_time, int longest_wait_time) {
-    log("calculating and printing summary statistics.");
-    double num_requests = static_cast<double>(io_requests.size());
-    double io_utilization = static_cast<double>(total_head_movement) / static_cast<double>(simulation_time);
-    double avg_turnaround_time = total_turnaround_time / num_requests;
-    double avg_wait_time = total_wait_time / num_requests;
-
-    std::printf("SUM: %d %d %.4f %.2f %.2f %d\n", simulation_time, total_head_movement,
-                io_utilization, avg_turnaround_time, avg_wait_time, longest_wait_time);
+// utilization is busy time over device_time, the summed clocks of the devices covered by stats
+void print_summary_stats(const string& label, int simulation_time, long long device_time, const IOStats& stats) {
+    LOG("calculating and printing summary statistics.");
+    double num_requests = static_cast<double>(stats.requests);
+    double io_utilization = static_cast<double>(stats.busy_time) / static_cast<double>(device_time);
+    double avg_turnaround_time = stats.total_turnaround_time / num_requests;
+    double avg_wait_time = stats.total_wait_time / num_requests;
+
+    std::printf("%s: %d %lld %.4f %.2f %.2f %d\n", label.c_str(), simulation_time, stats.total_head_movement,
+                io_utilization, avg_turnaround_time, avg_wait_time, stats.longest_wait_time);
+    if (print_percentiles) {
+        const LatencyHistogram& w = stats.wait_hist;
+        const LatencyHistogram& t = stats.turnaround_hist;
+        std::printf("PCT%s: wait p50=%lld p90=%lld p99=%lld p99.9=%lld turnaround p50=%lld p90=%lld p99=%lld p99.9=%lld\n",
+                    label.substr(3).c_str(), w.percentile(50), w.percentile(90), w.percentile(99), w.percentile(99.9),
+                    t.percentile(50), t.percentile(90), t.percentile(99), t.percentile(99.9));
+    }
 
-    log("summary statistics: Total Movement = " + std::to_string(total_head_movement) +
+    LOG("summary statistics: Total Movement = " + std::to_string(stats.total_head_movement) +
         ", IO Utilization = " + std::to_string(io_utilization) +
         ", Average Turnaround Time = " + std::to_string(avg_turnaround_time) +
         ", Average Wait Time = " + std::to_string(avg_wait_time) +
-        ", Max Wait Time = " + std::to_string(longest_wait_time) + ".");
+        ", Max Wait Time = " + std::to_string(stats.longest_wait_time) + ".");
 }
 
+// ADAPT line: decisions per policy, the number of switches, then "time:policy" for the initial policy and every switch
+void print_adaptive_timeline(const Device& dev, const AdaptiveSched& sch) {
+    std::printf("ADAPT%s:", devices.size() > 1 ? ("[" + to_string(dev.id) + "]").c_str() : "");
+    for (int p = 0; p < AdaptiveSched::POLICIES; ++p) { std::printf(" %c=%lld", AdaptiveSched::NAMES[p], sch.decisions[p]); }
+    std::printf(" switches=%zu", sch.switches.empty() ? 0 : sch.switches.size() - 1);
+    for (const pair<int, int>& s : sch.switches) { std::printf(" %d:%c", s.first, AdaptiveSched::NAMES[s.second]); }
+    std::printf("\n");
+}
+
+double jain_index(const vector<double>& x) {
+    double sum = 0.0, sum_sq = 0.0;
+    for (double v : x) { sum += v; sum_sq += v * v; }
+    return sum_sq > 0.0 ? sum * sum / (x.size() * sum_sq) : 1.0;
+}
+
+/*
+    Per-tenant report (-T). One TENANT[<stream>] line per stream: requests, throughput (requests
+    per 1000 time units between the stream's first arrival and last completion), average
+    turnaround, average wait, p50 and p99 wait, and the longest wait. Throughput mostly follows
+    what each stream asked for, so FAIRNESS gives Jain's index (sum x)^2 / (n * sum x^2) over the
+    tenants' average turnaround and average wait instead, then the number of tenants. 1 means every
+    tenant fared the same; 1/n means one tenant took all the delay.
+*/
+void print_tenant_report() {
+    size_t tenants = tenant_stream.size();
+    vector<IOStats> stats(tenants);
+    vector<int> first_arrival(tenants, std::numeric_limits<int>::max());
+    vector<int> last_finish(tenants, 0);
+    for (const Device& dev : devices) {
+        for (const IORequest& io : dev.io_requests) {
+            update_statistics(io, stats[io.tenant]);
+            first_arrival[io.tenant] = std::min(first_arrival[io.tenant], io.arrival_time);
+            last_finish[io.tenant] = std::max(last_finish[io.tenant], io.finish_time);
+        }
+    }
+
+    vector<int> order(tenants);
+    for (size_t t = 0; t < tenants; ++t) { order[t] = static_cast<int>(t); }
+    std::sort(order.begin(), order.end(), [](int a, int b) { return tenant_stream[a] < tenant_stream[b]; });
+
+    vector<double> avg_turnaround(tenants), avg_wait(tenants);
+    for (int t : order) {
+        const IOStats& st = stats[t];
+        int span = std::max(1, last_finish[t] - first_arrival[t]);
+        avg_turnaround[t] = st.total_turnaround_time / st.requests;
+        avg_wait[t] = st.total_wait_time / st.requests;
+        std::printf("TENANT[%d]: %zu %.4f %.2f %.2f %lld %lld %d\n", tenant_stream[t], st.requests, 1000.0 * st.requests / span,
+                    avg_turnaround[t], avg_wait[t], st.wait_hist.percentile(50), st.wait_hist.percentile(99), st.longest_wait_time);
+    }
+    std::printf("FAIRNESS: %.4f %.4f %zu\n", jain_index(avg_turnaround), jain_index(avg_wait), tenants);
+}
+
+/*
+    Request lines are printed in input order. With more than one device every device gets a
+    SUM[<id>] line, followed by the aggregate SUM line: the longest device time, total movement
+    over all heads, busy time / summed device time, and turnaround and wait over all requests.
+*/
 void print_summary() {
-    int total_head_movement = 0;
-    int longest_wait_time = 0;
-    double total_turnaround_time = 0.0;
-    double total_wait_time = 0.0;
+    IOStats total;
+    int makespan = 0;
+    long long device_time = 0;
+
+    vector<pair<const Device*, size_t> > by_input;
+    for (const Device& dev : devices) {
+        for (size_t i = 0; i < dev.io_requests.size(); ++i) {
+            if (dev.input_index[i] >= by_input.size()) { by_input.resize(dev.input_index[i] + 1); }
+            by_input[dev.input_index[i]] = make_pair(&dev, i);
+        }
+    }
 
-    log("printing details of each IO operation.");
-    print_io_details(total_head_movement, total_turnaround_time, total_wait_time, longest_wait_time); 
+    LOG("printing details of each IO operation.");
+    print_io_details(by_input); 
+
+    for (const Device& dev : devices) {
+        IOStats dev_stats;
+        for (const IORequest& io : dev.io_requests) { update_statistics(io, dev_stats); }
+        if (devices.size() > 1 && !dev.io_requests.empty()) {
+            print_summary_stats("SUM[" + to_string(dev.id) + "]", dev.simulation_time, dev.simulation_time, dev_stats);
+        }
+        total.merge(dev_stats);
+        makespan = std::max(makespan, dev.simulation_time);
+        device_time += dev.simulation_time;
+    }
+
+    LOG("Cclculating and printing summary statistics.");
+    print_summary_stats("SUM", makespan, device_time, total);
+
+    if (tenant_report) { print_tenant_report(); }
+
+    for (const Device& dev : devices) {
+        const AdaptiveSched* adaptive = dynamic_cast<const AdaptiveSched*>(dev.sch);
+        if (adaptive != nullptr && !dev.io_requests.empty()) { print_adaptive_timeline(dev, *adaptive); }
+    }
 
-    log("Cclculating and printing summary statistics.");
-    print_summary_stats(total_head_movement, total_turnaround_time, total_wait_time, longest_wait_time); 
+    if (record_dispatch) {
+        LatencyHistogram measured;
+        long long measured_total = 0;
+        for (const Device& dev : devices) {
+            for (const IORequest& io : dev.io_requests) {
+                if (io.measured_ns < 0) { continue; }
+                measured.record(io.measured_ns);
+                measured_total += io.measured_ns;
+            }
+        }
+        std::printf("REPLAY: %.1f p50=%.1f p99=%.1f p99.9=%.1f\n",
+                    total.requests ? measured_total / 1000.0 / total.requests : 0.0,
+                    measured.percentile(50) / 1000.0, measured.percentile(99) / 1000.0, measured.percentile(99.9) / 1000.0);
+    }
+
+    if (merge_requests) {
+        size_t merged = 0;
+        for (const Device& dev : devices) { merged += dev.merged_requests; }
+        std::printf("MERGE: %zu %zu %.4f\n", merged, total.requests,
+                    total.requests ? static_cast<double>(merged) / total.requests : 0.0);
+    }
+
+    if (!histogram_file.empty()) {
+        FILE* out = std::fopen(histogram_file.c_str(), "w");
+        if (out == nullptr) { cerr << "Error: Cannot open histogram file " << histogram_file << "." << endl; return; }
+        std::fprintf(out, "metric,low,high,count\n");
+        total.wait_hist.dump(out, "wait");
+        total.turnaround_hist.dump(out, "turnaround");
+        std::fclose(out);
+    }
+}
+
+
+
+/*
+    Request merging, as the block layer does before requests reach the elevator. A new request
+    whose sector range starts where a queued request on its track ends is appended to it (back
+    merge). One that ends where a queued request starts is prepended to it (front merge). Without
+    sector ranges in the input, every request on the same track merges. Only requests of the same
+    stream merge, so BFQ budgets and the -T report charge each request to its own stream. The
+    scheduler only sees the request everything was merged into, and all of them complete when it
+    does.
+*/
+
+MergeKey merge_key(const IORequest& io, int sector) {
+    return MergeKey{ io.stream, io.track, sector };
+}
+
+void index_for_merge(Device& dev, int io_task_id) {
+    const IORequest& io = dev.io_requests[io_task_id];
+    if (!io.has_range) { dev.merge_front[merge_key(io, -1)] = io_task_id; return; }
+    dev.merge_front[merge_key(io, io.sector)] = io_task_id;
+    dev.merge_back[merge_key(io, io.sector + io.size)] = io_task_id;
+}
+
+void unindex_for_merge(Device& dev, int io_task_id) {
+    const IORequest& io = dev.io_requests[io_task_id];
+    auto drop = [io_task_id](MergeIndex& index, const MergeKey& key) {
+        auto it = index.find(key);
+        if (it != index.end() && it->second == io_task_id) { index.erase(it); }
+    };
+    if (!io.has_range) { drop(dev.merge_front, merge_key(io, -1)); return; }
+    drop(dev.merge_front, merge_key(io, io.sector));
+    drop(dev.merge_back, merge_key(io, io.sector + io.size));
 }
 
+void attach_merged(Device& dev, int lead, int io_task_id) {
+    IORequest& io = dev.io_requests[io_task_id];
+    io.merged_into = lead;
+    io.next_merged = dev.io_requests[lead].next_merged;
+    dev.io_requests[lead].next_merged = io_task_id;
+    dev.merged_requests++;
+    LOG("merged IO request " + std::to_string(io_task_id) + " into " + std::to_string(lead) + ".");
+}
 
+// returns true if io_task_id was folded into a queued request and must not reach the scheduler
+bool try_merge(Device& dev, int io_task_id) {
+    IORequest& io = dev.io_requests[io_task_id];
+    if (!io.has_range) {
+        auto it = dev.merge_front.find(merge_key(io, -1));
+        if (it == dev.merge_front.end()) { index_for_merge(dev, io_task_id); return false; }
+        attach_merged(dev, it->second, io_task_id);
+        return true;
+    }
+    auto back = dev.merge_back.find(merge_key(io, io.sector));
+    if (back != dev.merge_back.end()) {
+        int lead = back->second;
+        unindex_for_merge(dev, lead);
+        dev.io_requests[lead].size += io.size;
+        index_for_merge(dev, lead);
+        attach_merged(dev, lead, io_task_id);
+        return true;
+    }
+    auto front = dev.merge_front.find(merge_key(io, io.sector + io.size));
+    if (front != dev.merge_front.end()) {
+        int lead = front->second;
+        unindex_for_merge(dev, lead);
+        dev.io_requests[lead].sector = io.sector;
+        dev.io_requests[lead].size += io.size;
+        index_for_merge(dev, lead);
+        attach_merged(dev, lead, io_task_id);
+        return true;
+    }
+    index_for_merge(dev, io_task_id);
+    return false;
+}
 
-void add_new_io_requests(int& io_ptr) {
-    log("adding new IO requests to the scheduler at simulation time " + std::to_string(simulation_time) + ".");
+// the scheduler handed out io_task_id: nothing can merge into it any more
+int dispatched(Device& dev, int io_task_id) {
+    if (merge_requests && io_task_id >= 0) { unindex_for_merge(dev, io_task_id); }
+    if (record_dispatch && io_task_id >= 0) { dev.dispatch_order.push_back(io_task_id); }
+    return io_task_id;
+}
 
+void add_new_io_requests(Device& dev, size_t& io_ptr) {
+    LOG("adding new IO requests to the scheduler at simulation time " + std::to_string(dev.simulation_time) + ".");
+    dev.arrival_batch.clear();
 
-    while (io_ptr < io_requests.size()) {
-        const IORequest& io = io_requests[io_ptr];
+    while (io_ptr < dev.io_requests.size()) {
+        const IORequest& io = dev.io_requests[io_ptr];
 
-        if (io.arrival_time > simulation_time) {
-            log("no more IO requests to add. get_next request arrives at time " + std::to_string(io.arrival_time) + ".");
+        if (io.arrival_time > dev.simulation_time) {
+            LOG("no more IO requests to add. get_next request arrives at time " + std::to_string(io.arrival_time) + ".");
             break; 
         }
 
-        if (io.arrival_time == simulation_time) {
-            log("adding IO request " + std::to_string(io_ptr) + " with track " + std::to_string(io.track) + ".");
-            sch->add(io_ptr);
+        if (io.arrival_time == dev.simulation_time) {
+            LOG("adding IO request " + std::to_string(io_ptr) + " with track " + std::to_string(io.track) + ".");
+            if (!merge_requests || !try_merge(dev, io_ptr)) { dev.arrival_batch.push_back(io_ptr); }
             io_ptr++;
         }
     }
+
+    if (dev.arrival_batch.size() == 1) { dev.sch->add(dev.arrival_batch[0]); }
+    else if (!dev.arrival_batch.empty()) { dev.sch->add_batch(dev.arrival_batch.data(), dev.arrival_batch.size()); }
+}
+
+void complete_io_request(Device& dev, int io_task_id) {
+    IORequest& io = dev.io_requests[io_task_id];
+    io.finish_time = dev.simulation_time;
+    for (int m = io.next_merged; m != -1; m = dev.io_requests[m].next_merged) {
+        dev.io_requests[m].start_time = io.start_time;
+        dev.io_requests[m].finish_time = io.finish_time;
+    }
+    LOG("IO request " + std::to_string(io_task_id) + " completed at time " +
+        std::to_string(dev.simulation_time) + ".");
+    dev.processing_io = -1; 
 }
 
-void complete_processing_io() {
-    if (processing_io == -1) {
-        log("no active IO request to complete.");
+void complete_processing_io(Device& dev) {
+    if (dev.processing_io == -1) {
+        LOG("no active IO request to complete.");
         return; 
     }
 
-    const IORequest& current_io = io_requests[processing_io];
-    if (current_io.track == current_track) {
-        io_requests[processing_io].finish_time = simulation_time;
-        log("completed IO request " + std::to_string(processing_io) +
+    const IORequest& current_io = dev.io_requests[dev.processing_io];
+    if (dev.simulation_time == dev.busy_until) {
+        dev.current_track = current_io.track;
+        LOG("completed IO request " + std::to_string(dev.processing_io) +
             " at track " + std::to_string(current_io.track) +
-            " at time " + std::to_string(simulation_time) + ".");
-        processing_io = -1; 
+            " at time " + std::to_string(dev.simulation_time) + ".");
+        complete_io_request(dev, dev.processing_io);
     }
 }
 
 
-void complete_io_request(int io_task_id) {
-    io_requests[io_task_id].finish_time = simulation_time;
-    log("IO request " + std::to_string(io_task_id) + " completed at time " +
-        std::to_string(simulation_time) + ".");
-    processing_io = -1; 
-}
-
-void start_io_request(int get_next_io) {
-    io_requests[get_next_io].start_time = simulation_time;
-    processing_io = get_next_io;
+void start_io_request(Device& dev, int get_next_io) {
+    dev.io_requests[get_next_io].start_time = dev.simulation_time;
+    dev.io_requests[get_next_io].movement = std::abs(dev.io_requests[get_next_io].track - dev.current_track);
+    dev.busy_until = dev.simulation_time + dev.seek_cost(dev.io_requests[get_next_io].track);
+    dev.processing_io = get_next_io;
 
 
 
-    if (io_requests[get_next_io].track == current_track) {
-        log("IO request " + std::to_string(get_next_io) +
+    if (dev.io_requests[get_next_io].track == dev.current_track) {
+        LOG("IO request " + std::to_string(get_next_io) +
             " is already at track head. Completing immediately.");
-        complete_io_request(get_next_io);
+        complete_io_request(dev, get_next_io);
     }
 }
 
-void process_get_next_io(int& io_ptr) {
-    while (processing_io == -1) {
-        int get_next_io = sch->get_next();
+void process_get_next_io(Device& dev, size_t& io_ptr) {
+    while (dev.processing_io == -1) {
+        int get_next_io = dispatched(dev, dev.sch->get_next());
 
         if (get_next_io == -1) {
-            if (io_ptr >= io_requests.size()) {
-                log("no more IO requests to process.");
+            if (io_ptr >= dev.io_requests.size()) {
+                LOG("no more IO requests to process.");
                 return; 
             }
-            log("no IO requests available in the scheduler.");
+            LOG("no IO requests available in the scheduler.");
             break; 
         }
-        log("processing get_next IO request " + std::to_string(get_next_io) + ".");
-        start_io_request(get_next_io);
+        LOG("processing get_next IO request " + std::to_string(get_next_io) + ".");
+        start_io_request(dev, get_next_io);
     }
 }
 
 //------------------------------------------------------------------------------------------------------------------------------
 
 
-void simulation() {
-    log("Starting simulation.");
-    int io_ptr = 0;  
+// runs until every request is done or the next event lies beyond until; returns true when done
+bool simulation(Device& dev, int until) {
+    if (dev.simulation_time == 0) { LOG("Starting simulation."); }
+    size_t& io_ptr = dev.next_input;
 
     while (true) {
-        add_new_io_requests(io_ptr);  
-        complete_processing_io();          
-        process_get_next_io(io_ptr);      
+        add_new_io_requests(dev, io_ptr);  
+        complete_processing_io(dev);          
+        process_get_next_io(dev, io_ptr);      
 
-        if (io_ptr >= io_requests.size() && processing_io == -1) {
-            log("All IO requests processed. Ending simulation.");
-            break; 
+        if (io_ptr >= dev.io_requests.size() && dev.processing_io == -1) {
+            LOG("All IO requests processed. Ending simulation.");
+            return true; 
         }
 
-        if (processing_io >= 0) {
-            int movement;
-            if (io_requests[processing_io].track > current_track) {
-                movement = 1;
+        // jump to the next arrival or completion; the head reaches its target when the seek ends
+        int next_event = std::numeric_limits<int>::max();
+        if (dev.processing_io >= 0) {
+            LOG("Moving track head from " + std::to_string(dev.current_track) + 
+                " to track " + std::to_string(dev.io_requests[dev.processing_io].track) +
+                ", arriving at time " + std::to_string(dev.busy_until));
+            next_event = dev.busy_until;
+        }
+        if (io_ptr < dev.io_requests.size()) { next_event = std::min(next_event, dev.io_requests[io_ptr].arrival_time); }
+        dev.simulation_time = next_event;
+        if (next_event > until) { return false; }
+    }
+}
+
+//------------------------------------------------------------------------------------------------------------------------------
+
+/*
+    NCQ model (-Q<depth>). The host scheduler hands up to queue_depth requests to the drive, which
+    serves its internal queue shortest-positioning-time-first: seek (from the seek model) plus
+    the rotational latency until the request's first sector comes under the head, plus one
+    time unit per sector of transfer. The platter turns once every rotation_period time units and
+    a track holds rotation_period sectors, so the head sits over sector (t % rotation_period) at
+    time t.
+*/
+int queue_depth = 0;        // 0 = classic model, head serves one request at a time
+int rotation_period = 12;
+
+int positioning_time(const Device& dev, const IORequest& io) {
+    int seek = dev.seek_cost(io.track);
+    int arrive = dev.simulation_time + seek;
+    int rotational_latency = ((io.sector - arrive) % rotation_period + rotation_period) % rotation_period;
+    return seek + rotational_latency;
+}
+
+// drive-side reordering: cheapest to reach from where the head is now, oldest dispatch on ties
+size_t select_from_device_queue(const Device& dev, const vector<int>& device_queue) {
+    size_t best = 0;
+    int best_cost = std::numeric_limits<int>::max();
+    for (size_t i = 0; i < device_queue.size(); ++i) {
+        int cost = positioning_time(dev, dev.io_requests[device_queue[i]]);
+        if (cost < best_cost) { best_cost = cost; best = i; }
+    }
+    return best;
+}
+
+bool simulation_ncq(Device& dev, int until) {
+    if (dev.simulation_time == 0) { LOG("Starting NCQ simulation with queue depth " + std::to_string(queue_depth) + "."); }
+    size_t& io_ptr = dev.next_input;
+    vector<int>& device_queue = dev.device_queue;
+    device_queue.reserve(queue_depth);
+
+    while (true) {
+        add_new_io_requests(dev, io_ptr);
+
+        if (dev.processing_io >= 0 && dev.simulation_time == dev.busy_until) {
+            dev.current_track = dev.io_requests[dev.processing_io].track;
+            complete_io_request(dev, dev.processing_io);
+        }
+
+        while (static_cast<int>(device_queue.size()) < queue_depth) {
+            int next_io = dispatched(dev, dev.sch->get_next());
+            if (next_io == -1) { break; }
+            LOG("dispatched IO request " + std::to_string(next_io) + " to the device queue.");
+            device_queue.push_back(next_io);
+        }
+
+        if (dev.processing_io == -1 && !device_queue.empty()) {
+            size_t pick = select_from_device_queue(dev, device_queue);
+            int io_task_id = device_queue[pick];
+            device_queue.erase(device_queue.begin() + pick);
+
+            IORequest& io = dev.io_requests[io_task_id];
+            io.start_time = dev.simulation_time;
+            io.movement = std::abs(io.track - dev.current_track);
+            dev.busy_until = dev.simulation_time + positioning_time(dev, io) + io.size;
+            dev.processing_io = io_task_id;
+            LOG("device started IO request " + std::to_string(io_task_id) + " at track " + std::to_string(io.track) +
+                ", done at " + std::to_string(dev.busy_until) + ".");
+        }
+
+        if (io_ptr >= dev.io_requests.size() && dev.processing_io == -1 && device_queue.empty()) {
+            LOG("All IO requests processed. Ending simulation.");
+            return true;
+        }
+
+        int next_event = std::numeric_limits<int>::max();
+        if (dev.processing_io >= 0) { next_event = dev.busy_until; }
+        if (io_ptr < dev.io_requests.size()) { next_event = std::min(next_event, dev.io_requests[io_ptr].arrival_time); }
+        dev.simulation_time = next_event;
+        if (next_event > until) { return false; }
+    }
+}
+
+// devices share nothing, so with jobs > 1 worker threads just pull the next unsimulated device
+void simulate_device(Device& dev, int until = std::numeric_limits<int>::max()) {
+    if (dev.finished) { return; }
+    dev.finished = queue_depth > 0 ? simulation_ncq(dev, until) : simulation(dev, until);
+}
+
+//------------------------------------------------------------------------------------------------------------------------------
+
+/*
+    Checkpoints (-C<file> -I<interval>). The devices are simulated in epochs of interval time
+    units. At the end of each epoch every device has stopped before its first event past the
+    epoch, and a snapshot (see snapshot.h) of all of them is written in the background: requests
+    with their times so far, head, clock, pending arrivals, merge indexes, NCQ queue and the
+    scheduler's queues and sweep state. -L<file> resumes from one with the same input and
+    options and prints the same results as the uninterrupted run. Without -I there is a single
+    epoch and nothing is written.
+*/
+string checkpoint_file;
+string restore_file;
+int checkpoint_every = 0;
+int epoch_end = 0;           // devices have been simulated up to here
+static const char SCHED_SNAPSHOT_MAGIC[8] = { 'I', 'O', 'S', 'N', 'A', 'P', '0', '4' };
+
+// everything the device state depends on besides the input itself
+string snapshot_fingerprint(char alg, const string& input, const string& seek_spec) {
+    ostringstream fp;
+    fp << alg << ' ' << input << ' ' << (seek_spec.compare(0, 2, "t:") == 0 ? "t:" + Snapshot::file_identity(seek_spec.substr(2)) : seek_spec)
+       << ' ' << num_devices << ' ' << queue_depth << ' ' << rotation_period << ' '
+       << merge_requests << ' ' << record_dispatch << ' ' << deadline_expire << ' ' << bfq_budget << ' '
+       << adapt_window << ' ' << devices.size();
+    return fp.str();
+}
+
+void save_devices(Snapshot& s) {
+    s.put(epoch_end);
+    for (const Device& dev : devices) {
+        s.put_vector(dev.io_requests);
+        s.put(dev.current_track); s.put(dev.processing_io); s.put(dev.simulation_time); s.put(dev.busy_until);
+        s.put_vector(vector<pair<MergeKey, int> >(dev.merge_front.begin(), dev.merge_front.end()));
+        s.put_vector(vector<pair<MergeKey, int> >(dev.merge_back.begin(), dev.merge_back.end()));
+        s.put(dev.merged_requests);
+        s.put_vector(dev.dispatch_order);
+        s.put(dev.next_input);
+        s.put_vector(dev.device_queue);
+        s.put(dev.finished);
+        dev.sch->save(s);
+    }
+}
+
+// the devices were read from the same input and have fresh schedulers
+void restore_devices(const string& fingerprint) {
+    Snapshot s;
+    s.read_file(restore_file);
+    s.check(SCHED_SNAPSHOT_MAGIC, fingerprint);
+    s.get(epoch_end);
+    for (Device& dev : devices) {
+        s.get_vector(dev.io_requests);
+        s.get(dev.current_track); s.get(dev.processing_io); s.get(dev.simulation_time); s.get(dev.busy_until);
+        vector<pair<MergeKey, int> > index;
+        s.get_vector(index);
+        dev.merge_front = MergeIndex(index.begin(), index.end());
+        s.get_vector(index);
+        dev.merge_back = MergeIndex(index.begin(), index.end());
+        s.get(dev.merged_requests);
+        s.get_vector(dev.dispatch_order);
+        s.get(dev.next_input);
+        s.get_vector(dev.device_queue);
+        s.get(dev.finished);
+        dev.sch->load(s);
+    }
+}
+
+void run_epoch(int jobs, int until) {
+    atomic<size_t> next_device(0);
+    auto worker = [&next_device, until]() {
+        for (size_t d = next_device++; d < devices.size(); d = next_device++) { simulate_device(devices[d], until); }
+    };
+    int workers = std::min<int>(jobs, devices.size());
+    if (workers <= 1) { worker(); return; }
+
+    LOG("simulating " + std::to_string(devices.size()) + " devices on " + std::to_string(workers) + " threads.");
+    vector<thread> pool;
+    for (int i = 0; i < workers; i++) { pool.emplace_back(worker); }
+    for (thread& t : pool) { t.join(); }
+}
+
+void run_devices(int jobs, const string& fingerprint = "") {
+    if (checkpoint_every == 0) { run_epoch(jobs, std::numeric_limits<int>::max()); return; }
+
+    Snapshot snap;
+    auto all_finished = []() {
+        for (const Device& dev : devices) { if (!dev.finished) { return false; } }
+        return true;
+    };
+    while (!all_finished()) {
+        epoch_end = epoch_end > std::numeric_limits<int>::max() - checkpoint_every ? std::numeric_limits<int>::max()
+                                                                                    : epoch_end + checkpoint_every;
+        run_epoch(jobs, epoch_end);
+        if (!checkpoint_file.empty() && !all_finished()) {
+            LOG("writing checkpoint at time " + std::to_string(epoch_end) + ".");
+            snap.write_in_background(checkpoint_file, [&fingerprint](Snapshot& s) {
+                s.begin(SCHED_SNAPSHOT_MAGIC, fingerprint);
+                save_devices(s);
+            });
+        }
+    }
+}
+
+// param overrides the scheduler's tunable (D: deadline expiry, B: budget, A: window) when positive
+Scheduler* make_scheduler(char alg, Device& dev, int param = 0) {
+    switch (alg) {
+        case 'N': return new FIFOSched(dev);
+        case 'S': return new SSTFSched(dev);
+        case 'L': return new LOOKSched(dev);
+        case 'C': return new CLOOKSched(dev);
+        case 'F': return new FLOOKSched(dev);
+        case 'D': return new DeadlineSched(dev, param > 0 ? param : deadline_expire);
+        case 'B': return new BFQSched(dev, param > 0 ? param : bfq_budget);
+        case 'A': return new AdaptiveSched(dev, param > 0 ? param : adapt_window);
+        default:  return nullptr;
+    }
+}
+
+//------------------------------------------------------------------------------------------------------------------------------
+
+/*
+    Comparison mode (-c<variants>). The input is parsed once, then every variant runs on its own
+    copy of the devices, so the parsed requests are never written to. Variants are
+    comma-separated algorithm letters, optionally with a parameter after a colon (D:250 is
+    deadline with expiry 250, B:500 is BFQ with budget 500, A:128 is the adaptive scheduler with
+    a 128-decision window); "all" stands for N,S,L,C,F,D,B,A. Up to -j
+    variants are simulated at once. The table lists them in the order given, and every column
+    equals the SUM (and PCT) line of the matching single-algorithm run.
+*/
+struct Variant {
+    char alg;
+    int param;
+    string name;
+};
+
+struct ComparisonRow {
+    int makespan = 0;
+    long long device_time = 0;
+    IOStats stats;
+};
+
+bool parse_variants(const string& spec, vector<Variant>& variants) {
+    std::istringstream iss(spec);
+    string item;
+    while (std::getline(iss, item, ',')) {
+        if (item.empty()) { continue; }
+        if (item == "all") {
+            for (char alg : string("NSLCFDBA")) { variants.push_back(Variant{ alg, 0, string(1, alg) }); }
+            continue;
+        }
+        Variant v = { item[0], 0, item };
+        if (string("NSLCFDBA").find(v.alg) == string::npos) {
+            cerr << "Error: Unknown scheduler '" << item << "' in comparison list." << endl;
+            return false;
+        }
+        if (item.size() > 1) {
+            if (item[1] != ':' || (v.param = atoi(item.c_str() + 2)) <= 0) {
+                cerr << "Error: Bad scheduler parameter in '" << item << "'." << endl;
+                return false;
+            }
+        }
+        variants.push_back(v);
+    }
+    return !variants.empty();
+}
+
+ComparisonRow run_variant(const Variant& v) {
+    vector<Device> copy(devices);
+    ComparisonRow row;
+    for (Device& dev : copy) {
+        dev.sch = make_scheduler(v.alg, dev, v.param);
+        simulate_device(dev);
+        delete dev.sch;
+        dev.sch = nullptr;
+        for (const IORequest& io : dev.io_requests) { update_statistics(io, row.stats); }
+        row.makespan = std::max(row.makespan, dev.simulation_time);
+        row.device_time += dev.simulation_time;
+    }
+    return row;
+}
+
+void run_comparison(const vector<Variant>& variants, int jobs) {
+    vector<ComparisonRow> rows(variants.size());
+    atomic<size_t> next_variant(0);
+    auto worker = [&]() {
+        for (size_t i = next_variant++; i < variants.size(); i = next_variant++) { rows[i] = run_variant(variants[i]); }
+    };
+    int workers = std::min<int>(jobs, variants.size());
+    if (workers <= 1) { worker(); }
+    else {
+        vector<thread> pool;
+        for (int i = 0; i < workers; i++) { pool.emplace_back(worker); }
+        for (thread& t : pool) { t.join(); }
+    }
+
+    std::printf("%-8s %9s %10s %7s %9s %9s %8s %8s %8s\n",
+                "sched", "time", "movement", "util", "avg_tat", "avg_wait", "max_wait", "p50_wait", "p99_wait");
+    for (size_t i = 0; i < variants.size(); ++i) {
+        const IOStats& st = rows[i].stats;
+        double n = static_cast<double>(st.requests);
+        std::printf("%-8s %9d %10lld %7.4f %9.2f %9.2f %8d %8lld %8lld\n", variants[i].name.c_str(), rows[i].makespan,
+                    st.total_head_movement, static_cast<double>(st.busy_time) / rows[i].device_time,
+                    st.total_turnaround_time / n, st.total_wait_time / n, st.longest_wait_time,
+                    st.wait_hist.percentile(50), st.wait_hist.percentile(99));
+    }
+}
+
+//------------------------------------------------------------------------------------------------------------------------------
+
+/*
+    Concurrent submission front-end, for using the schedulers from a multi-threaded storage engine.
+    Producer threads push requests into a bounded lock-free MPSC ring (a per-slot sequence number
+    tells producers which slots are free and the consumer which slots are filled). A single
+    dispatcher thread drains the ring in batches into one Device's Scheduler and dispatches from it.
+    It posts each completion to the submitting producer's SPSC channel. Request ids are recycled
+    once completed, so io_requests stays as small as the number of requests in flight.
+    Two latencies are kept per request. ring_wait runs from submit to the dispatcher popping the
+    request, and is mostly backpressure when producers outrun the dispatcher. dispatch_latency
+    is the dispatcher's cost per request: one get_next() plus posting the completion.
+*/
+struct Submission {
+    int producer;
+    int track;
+    long long tag;              // opaque to the dispatcher, handed back with the completion
+    long long submit_ns;
+};
+
+struct Completion {
+    long long tag;
+    long long dispatch_ns;
+};
+
+static inline long long now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+class SubmissionQueue {
+public:
+    explicit SubmissionQueue(size_t capacity_pow2) : mask(capacity_pow2 - 1), slots(capacity_pow2) {
+        for (size_t i = 0; i < capacity_pow2; ++i) { slots[i].seq.store(i, std::memory_order_relaxed); }
+    }
+
+    bool try_push(const Submission& s) {
+        size_t pos = tail.load(std::memory_order_relaxed);
+        Slot* slot;
+        while (true) {
+            slot = &slots[pos & mask];
+            size_t seq = slot->seq.load(std::memory_order_acquire);
+            long long diff = static_cast<long long>(seq) - static_cast<long long>(pos);
+            if (diff == 0) {
+                if (tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) { break; }
+            } else if (diff < 0) {
+                return false;   // full
             } else {
-                movement = -1;
+                pos = tail.load(std::memory_order_relaxed);
             }
-            
-            log("Moving track head from " + std::to_string(current_track) + 
-                " to " + std::to_string(current_track + movement) +
-                " to reach track " + std::to_string(io_requests[processing_io].track));
-            
-            current_track += movement;
         }
+        slot->value = s;
+        slot->seq.store(pos + 1, std::memory_order_release);
+        return true;
+    }
 
-        simulation_time++;              
+    // single consumer only
+    size_t pop_batch(Submission* out, size_t max) {
+        size_t n = 0;
+        while (n < max) {
+            Slot& slot = slots[head & mask];
+            if (slot.seq.load(std::memory_order_acquire) != head + 1) { break; }
+            out[n++] = slot.value;
+            slot.seq.store(head + mask + 1, std::memory_order_release);
+            head++;
+        }
+        return n;
+    }
+
+private:
+    struct alignas(64) Slot {
+        atomic<size_t> seq;
+        Submission value;
+    };
+    const size_t mask;
+    vector<Slot> slots;
+    alignas(64) atomic<size_t> tail{0};
+    alignas(64) size_t head = 0;
+};
+
+class CompletionChannel {
+public:
+    explicit CompletionChannel(size_t capacity_pow2) : mask(capacity_pow2 - 1), items(capacity_pow2) {}
+
+    bool try_push(const Completion& c) {
+        size_t t = tail.load(std::memory_order_relaxed);
+        if (t - head.load(std::memory_order_acquire) > mask) { return false; }
+        items[t & mask] = c;
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool try_pop(Completion& c) {
+        size_t h = head.load(std::memory_order_relaxed);
+        if (h == tail.load(std::memory_order_acquire)) { return false; }
+        c = items[h & mask];
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    const size_t mask;
+    vector<Completion> items;
+    alignas(64) atomic<size_t> head{0};
+    alignas(64) atomic<size_t> tail{0};
+};
+
+class IODispatcher {
+public:
+    IODispatcher(char alg, int producers, size_t ring_capacity = 4096, size_t channel_capacity = 1024)
+        : ring(ring_capacity) {
+        dev.sch = make_scheduler(alg, dev);
+        for (int p = 0; p < producers; ++p) { channels.emplace_back(new CompletionChannel(channel_capacity)); }
+    }
+    ~IODispatcher() {
+        delete dev.sch;
+        for (CompletionChannel* c : channels) { delete c; }
+    }
+
+    bool submit(const Submission& s) { return ring.try_push(s); }
+    bool poll(int producer, Completion& c) { return channels[producer]->try_pop(c); }
+
+    // one dispatcher round: drain a batch into the scheduler, then dispatch everything queued
+    size_t run_once() {
+        Submission batch[BATCH];
+        size_t n = ring.pop_batch(batch, BATCH);
+        long long popped = now_ns();
+        for (size_t i = 0; i < n; ++i) {
+            int id = allocate_id();
+            IORequest& io = dev.io_requests[id];
+            io = IORequest(dev.simulation_time, batch[i].track);
+            io.stream = batch[i].producer;
+            owners[id] = batch[i];
+            ring_wait.record(popped - batch[i].submit_ns);
+            dev.sch->add(id);
+        }
+        while (true) {
+            long long start = now_ns();
+            int id = dev.sch->get_next();
+            if (id == -1) { break; }
+            const Submission& s = owners[id];
+            dev.current_track = dev.io_requests[id].track;
+            Completion c = { s.tag, now_ns() };
+            while (!channels[s.producer]->try_push(c)) { std::this_thread::yield(); }
+            dispatch_latency.record(now_ns() - start);
+            free_ids.push_back(id);
+        }
+        return n;
+    }
+
+    LatencyHistogram ring_wait;
+    LatencyHistogram dispatch_latency;
+
+
+private:
+    static const size_t BATCH = 64;
+    SubmissionQueue ring;
+    vector<CompletionChannel*> channels;
+    Device dev;
+    vector<Submission> owners;
+    vector<int> free_ids;
+
+    int allocate_id() {
+        if (!free_ids.empty()) { int id = free_ids.back(); free_ids.pop_back(); return id; }
+        dev.io_requests.emplace_back(0, 0);
+        owners.emplace_back();
+        return static_cast<int>(dev.io_requests.size()) - 1;
+    }
+};
+
+// -B<max>: submission throughput, ring wait and per-request dispatch latency for 1, 2, 4, ... max
+// producer threads. Producers submit as fast as they can, so the ring stays near full and
+// ring_wait is dominated by queueing behind it; dispatch is the dispatcher's own cost.
+void run_submission_benchmark(char alg, int max_producers) {
+    const long long TOTAL = 1 << 20;
+    std::printf("%9s  %12s  %14s  %14s  %14s  %14s  %14s\n", "producers", "submit/s", "ring_wait_p50", "ring_wait_p99",
+                "dispatch_p50", "dispatch_p99", "dispatch_p99.9");
+    for (int producers = 1; producers <= max_producers; producers *= 2) {
+        IODispatcher dispatcher(alg, producers);
+        long long per_producer = TOTAL / producers;
+        atomic<int> done(0);
+
+        long long start = now_ns();
+        vector<thread> pool;
+        for (int p = 0; p < producers; ++p) {
+            pool.emplace_back([&dispatcher, &done, p, per_producer]() {
+                unsigned int x = 2463534242u + p;
+                long long completed = 0;
+                Completion c;
+                for (long long i = 0; i < per_producer; ++i) {
+                    x ^= x << 13; x ^= x >> 17; x ^= x << 5;
+                    Submission s = { p, static_cast<int>(x % 512), i, now_ns() };
+                    while (!dispatcher.submit(s)) {
+                        while (dispatcher.poll(p, c)) { completed++; }
+                        std::this_thread::yield();
+                    }
+                    while (dispatcher.poll(p, c)) { completed++; }
+                }
+                while (completed < per_producer) {
+                    if (dispatcher.poll(p, c)) { completed++; } else { std::this_thread::yield(); }
+                }
+                done++;
+            });
+        }
+        while (done.load() < producers) {
+            if (dispatcher.run_once() == 0) { std::this_thread::yield(); }
+        }
+        long long elapsed = now_ns() - start;
+        for (thread& t : pool) { t.join(); }
+
+        const LatencyHistogram& w = dispatcher.ring_wait;
+        const LatencyHistogram& h = dispatcher.dispatch_latency;
+        std::printf("%9d  %12.0f  %12lldns  %12lldns  %12lldns  %12lldns  %12lldns\n", producers,
+                    per_producer * producers * 1e9 / elapsed, w.percentile(50), w.percentile(99),
+                    h.percentile(50), h.percentile(99), h.percentile(99.9));
+    }
+}
+
+// -U<burst>: cost of handing a burst of same-tick arrivals to each scheduler one add() at a time
+// versus one add_batch(). Only the hand-over is timed; draining the queue afterwards is not.
+void run_batch_benchmark(int burst) {
+    // the list-based schedulers drain in O(burst^2), so large bursts get fewer rounds
+    const long long TOTAL = 1 << 20;
+    long long b = burst;
+    int rounds = static_cast<int>(std::max(4LL, std::min(TOTAL / b, (TOTAL << 4) / (b * b))));
+    Device dev;
+    unsigned int x = 2463534242u;
+    for (int i = 0; i < burst; ++i) {
+        x ^= x << 13; x ^= x >> 17; x ^= x << 5;
+        dev.io_requests.emplace_back(0, static_cast<int>(x % 512));
+        dev.io_requests.back().stream = static_cast<int>((x >> 9) % 8);
+    }
+    vector<int> ids(burst);
+    for (int i = 0; i < burst; ++i) { ids[i] = i; }
+
+    // returns ns per request; the first round's dispatch order goes to order
+    auto measure = [&](char alg, bool batched, vector<int>& order) {
+        Scheduler* sch = make_scheduler(alg, dev);
+        long long timed = 0;
+        for (int r = 0; r < rounds; ++r) {
+            dev.current_track = 0;
+            long long start = now_ns();
+            if (batched) { sch->add_batch(ids.data(), ids.size()); }
+            else { for (int id : ids) { sch->add(id); } }
+            timed += now_ns() - start;
+            int id;
+            while ((id = sch->get_next()) >= 0) {
+                if (r == 0) { order.push_back(id); }
+                dev.current_track = dev.io_requests[id].track;
+            }
+        }
+        delete sch;
+        return static_cast<double>(timed) / (static_cast<double>(rounds) * burst);
+    };
+
+    std::printf("burst %d, %d rounds\n", burst, rounds);
+    std::printf("%5s  %12s  %12s  %8s\n", "sched", "add ns/req", "batch ns/req", "speedup");
+    for (char alg : string("NSLCFDB")) {
+        vector<int> single_order, batch_order;
+        double single = measure(alg, false, single_order);
+        double batched = measure(alg, true, batch_order);
+        std::printf("%5c  %12.1f  %12.1f  %7.2fx%s\n", alg, single, batched, single / batched,
+                    single_order == batch_order ? "" : "  (dispatch order differs!)");
+    }
+}
+
+// -Y<max depth>: steady-state cost of one get_next() plus the add() that refills the queue, for
+// every scheduler at queue depths 1, 4, 16, ... up to max depth
+void run_get_next_benchmark(int max_depth) {
+    std::printf("%5s", "depth");
+    for (char alg : string("NSLCFDB")) { std::printf("  %8c", alg); }
+    std::printf("   (ns per get_next + add)\n");
+    for (int depth = 1; depth <= max_depth; depth *= 4) {
+        long long ops = std::min(1LL << 18, std::max(4000LL, (1LL << 22) / depth));
+        std::printf("%5d", depth);
+        for (char alg : string("NSLCFDB")) {
+            Device dev;
+            unsigned int x = 2463534242u;
+            auto next_track = [&x]() { x ^= x << 13; x ^= x >> 17; x ^= x << 5; return static_cast<int>(x % 512); };
+            Scheduler* sch = make_scheduler(alg, dev);
+            for (int i = 0; i < depth; ++i) {
+                dev.io_requests.emplace_back(0, next_track());
+                dev.io_requests.back().stream = i % 4;
+                sch->add(i);
+            }
+            long long start = now_ns();
+            for (long long op = 0; op < ops; ++op) {
+                int id = sch->get_next();
+                IORequest& io = dev.io_requests[id];
+                dev.current_track = io.track;
+                dev.simulation_time++;
+                io.arrival_time = dev.simulation_time;
+                io.track = next_track();
+                sch->add(id);
+            }
+            std::printf("  %8.1f", static_cast<double>(now_ns() - start) / ops);
+            delete sch;
+        }
+        std::printf("\n");
+    }
+}
+
+//------------------------------------------------------------------------------------------------------------------------------
+
+/*
+    Replay mode (-X<file>). After the simulation, every device's requests are read from a local
+    file or loop device in the order its scheduler dispatched them, with up to replay_depth reads in
+    flight through io_uring (-K<depth>, -O for O_DIRECT). Track t maps to byte offset
+    t * REPLAY_TRACK_BYTES, plus sector * REPLAY_BLOCK when the input gives sector ranges. Offsets
+    wrap at the end of the file. Only reads are issued, so the target's contents are never
+    touched. Each request line gets its measured latency in microseconds after the simulated
+    times, and a REPLAY line gives the mean and percentiles. Requests merged into another one get
+    that request's latency. Where io_uring is unavailable the replay
+    falls back to pread() with one read in flight.
+*/
+string replay_target;
+int replay_depth = 1;
+bool replay_direct = false;
+
+const long long REPLAY_BLOCK = 4096;
+const long long REPLAY_TRACK_BYTES = 256 * 1024;
+
+class UringReader {
+public:
+    ~UringReader() {
+        if (sq_ptr != MAP_FAILED) { munmap(sq_ptr, sq_len); }
+        if (cq_ptr != MAP_FAILED && cq_ptr != sq_ptr) { munmap(cq_ptr, cq_len); }
+        if (sqes != MAP_FAILED) { munmap(sqes, sqes_len); }
+        if (ring_fd >= 0) { close(ring_fd); }
+    }
+
+    bool setup(unsigned entries) {
+        io_uring_params p;
+        std::memset(&p, 0, sizeof(p));
+        ring_fd = static_cast<int>(syscall(__NR_io_uring_setup, entries, &p));
+        if (ring_fd < 0) { return false; }
+
+        sq_len = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+        cq_len = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+        if (p.features & IORING_FEAT_SINGLE_MMAP) { sq_len = cq_len = std::max(sq_len, cq_len); }
+        sq_ptr = mmap(nullptr, sq_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQ_RING);
+        if (sq_ptr == MAP_FAILED) { return false; }
+        cq_ptr = (p.features & IORING_FEAT_SINGLE_MMAP) ? sq_ptr
+               : mmap(nullptr, cq_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_CQ_RING);
+        if (cq_ptr == MAP_FAILED) { return false; }
+        sqes_len = p.sq_entries * sizeof(io_uring_sqe);
+        sqes = mmap(nullptr, sqes_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQES);
+        if (sqes == MAP_FAILED) { return false; }
+
+        char* sq = static_cast<char*>(sq_ptr);
+        char* cq = static_cast<char*>(cq_ptr);
+        sq_tail = reinterpret_cast<unsigned*>(sq + p.sq_off.tail);
+        sq_mask = reinterpret_cast<unsigned*>(sq + p.sq_off.ring_mask);
+        sq_array = reinterpret_cast<unsigned*>(sq + p.sq_off.array);
+        cq_head = reinterpret_cast<unsigned*>(cq + p.cq_off.head);
+        cq_tail = reinterpret_cast<unsigned*>(cq + p.cq_off.tail);
+        cq_mask = reinterpret_cast<unsigned*>(cq + p.cq_off.ring_mask);
+        cqes = reinterpret_cast<io_uring_cqe*>(cq + p.cq_off.cqes);
+        return true;
+    }
+
+    void queue_read(int fd, void* buf, unsigned len, long long offset, unsigned long long user_data) {
+        unsigned tail = *sq_tail;
+        unsigned index = tail & *sq_mask;
+        io_uring_sqe* sqe = static_cast<io_uring_sqe*>(sqes) + index;
+        std::memset(sqe, 0, sizeof(*sqe));
+        sqe->opcode = IORING_OP_READ;
+        sqe->fd = fd;
+        sqe->addr = reinterpret_cast<unsigned long long>(buf);
+        sqe->len = len;
+        sqe->off = offset;
+        sqe->user_data = user_data;
+        sq_array[index] = index;
+        __atomic_store_n(sq_tail, tail + 1, __ATOMIC_RELEASE);
+        pending_submit++;
+    }
+
+    // submit queued reads and wait for at least one completion
+    bool submit_and_wait() {
+        int ret = static_cast<int>(syscall(__NR_io_uring_enter, ring_fd, pending_submit, 1, IORING_ENTER_GETEVENTS, nullptr, 0));
+        if (ret < 0) { return false; }
+        pending_submit = 0;
+        return true;
+    }
+
+    bool reap(unsigned long long& user_data, int& result) {
+        unsigned head = *cq_head;
+        if (head == __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE)) { return false; }
+        const io_uring_cqe& cqe = cqes[head & *cq_mask];
+        user_data = cqe.user_data;
+        result = cqe.res;
+        __atomic_store_n(cq_head, head + 1, __ATOMIC_RELEASE);
+        return true;
     }
+
+private:
+    int ring_fd = -1;
+    unsigned pending_submit = 0;
+    void* sq_ptr = MAP_FAILED;
+    void* cq_ptr = MAP_FAILED;
+    void* sqes = MAP_FAILED;
+    size_t sq_len = 0, cq_len = 0, sqes_len = 0;
+    unsigned *sq_tail = nullptr, *sq_mask = nullptr, *sq_array = nullptr;
+    unsigned *cq_head = nullptr, *cq_tail = nullptr, *cq_mask = nullptr;
+    io_uring_cqe* cqes = nullptr;
+};
+
+struct ReplayRead {
+    long long offset;
+    unsigned length;
+};
+
+ReplayRead replay_read_of(const IORequest& io, long long file_size) {
+    long long length = std::max(1, io.size) * REPLAY_BLOCK;
+    long long offset = static_cast<long long>(io.track) * REPLAY_TRACK_BYTES;
+    if (io.has_range) { offset += static_cast<long long>(io.sector) * REPLAY_BLOCK; }
+    long long span = std::max(REPLAY_BLOCK, (file_size - length) / REPLAY_BLOCK * REPLAY_BLOCK);
+    offset %= span;
+    return ReplayRead{ offset, static_cast<unsigned>(length) };
+}
+
+// replays one device's dispatch order; returns false if reads failed
+bool replay_device(Device& dev, int fd, long long file_size, UringReader* ring) {
+    size_t max_len = REPLAY_BLOCK;
+    for (int id : dev.dispatch_order) { max_len = std::max<size_t>(max_len, replay_read_of(dev.io_requests[id], file_size).length); }
+    int depth = ring ? replay_depth : 1;
+    vector<void*> buffers(depth, nullptr);
+    for (void*& b : buffers) {
+        if (posix_memalign(&b, REPLAY_BLOCK, max_len) != 0) { cerr << "Error: Out of memory for replay buffers." << endl; return false; }
+    }
+    vector<int> free_slots;
+    for (int i = depth - 1; i >= 0; --i) { free_slots.push_back(i); }
+    vector<long long> issued_at(depth);
+    vector<int> slot_request(depth);
+    bool ok = true;
+
+    auto finish = [&dev](int id, long long latency) {
+        dev.io_requests[id].measured_ns = latency;
+        for (int m = dev.io_requests[id].next_merged; m != -1; m = dev.io_requests[m].next_merged) {
+            dev.io_requests[m].measured_ns = latency;
+        }
+    };
+
+    size_t next = 0, in_flight = 0;
+    while (next < dev.dispatch_order.size() || in_flight > 0) {
+        if (ring == nullptr) {
+            int id = dev.dispatch_order[next++];
+            ReplayRead r = replay_read_of(dev.io_requests[id], file_size);
+            long long t = now_ns();
+            if (pread(fd, buffers[0], r.length, r.offset) < 0) { ok = false; }
+            finish(id, now_ns() - t);
+            continue;
+        }
+        while (next < dev.dispatch_order.size() && !free_slots.empty()) {
+            int slot = free_slots.back();
+            free_slots.pop_back();
+            int id = dev.dispatch_order[next++];
+            ReplayRead r = replay_read_of(dev.io_requests[id], file_size);
+            slot_request[slot] = id;
+            issued_at[slot] = now_ns();
+            ring->queue_read(fd, buffers[slot], r.length, r.offset, slot);
+            in_flight++;
+        }
+        if (!ring->submit_and_wait()) { ok = false; break; }
+        unsigned long long slot;
+        int result;
+        while (ring->reap(slot, result)) {
+            if (result < 0) { ok = false; }
+            finish(slot_request[slot], now_ns() - issued_at[slot]);
+            free_slots.push_back(static_cast<int>(slot));
+            in_flight--;
+        }
+    }
+    for (void* b : buffers) { free(b); }
+    return ok;
+}
+
+bool replay_on_target() {
+    int flags = O_RDONLY | (replay_direct ? O_DIRECT : 0);
+    int fd = open(replay_target.c_str(), flags);
+    if (fd < 0) { cerr << "Error: Cannot open replay target " << replay_target << "." << endl; return false; }
+    long long file_size = lseek(fd, 0, SEEK_END);
+    if (file_size < REPLAY_BLOCK) { cerr << "Error: Replay target is smaller than one block." << endl; close(fd); return false; }
+
+    UringReader ring;
+    bool have_ring = ring.setup(static_cast<unsigned>(replay_depth));
+    if (!have_ring) { cerr << "Warning: io_uring unavailable, replaying with pread at depth 1." << endl; }
+
+    bool ok = true;
+    for (Device& dev : devices) { ok = replay_device(dev, fd, file_size, have_ring ? &ring : nullptr) && ok; }
+    close(fd);
+    if (!ok) { cerr << "Warning: some replay reads failed." << endl; }
+    return ok;
 }
 
 //------------------------------------------------------------------------------------------------------------------------------
 
 int main(int argc, char* argv[]) {
     char alg = '\0';
+    int jobs = 1;
+    int bench_producers = 0;
+    int bench_burst = 0;
+    int bench_depth = 0;
+    std::string compare_spec;
+    std::string workload_spec;
+    bool emit = false;
+    bool replay_ok = true;
     std::string inputfile;
+    std::string seek_spec;
 
-    log("Disk Scheduler simulation started.");
+    LOG("Disk Scheduler simulation started.");
 
     int opt;
-    while ((opt = getopt(argc, argv, "s:vqf")) != -1) {
+    while ((opt = getopt(argc, argv, "s:vqfd:j:Q:R:m:e:b:w:PH:TMB:U:Y:X:K:Oc:g:EC:I:L:")) != -1) {
         switch (opt) {
             case 's': // scheduler 
                 if (optarg != nullptr) {
                     alg = optarg[0];
-                    log("Scheduler algorithm set to: " + string(1, alg));
+                    LOG("Scheduler algorithm set to: " + string(1, alg));
                 } 
                 else { cerr << "Error: Missing argument for -s option." << endl; return 1;}
                 break;
             case 'v': // verbose 
                 vMode = true;
-                log("Verbose mode enabled.");
+                LOG("Verbose mode enabled.");
                 break;
             case 'q': // queue debug
-                log("Queue debug mode enabled.");
+                LOG("Queue debug mode enabled.");
                 break;
             case 'f': //  FLOOK debug
-                log("FLOOK debug mode enabled.");
+                LOG("FLOOK debug mode enabled.");
+                break;
+            case 'd': // devices for requests without a device column
+                num_devices = atoi(optarg);
+                if (num_devices <= 0) { cerr << "Error: Number of devices must be positive." << endl; return 1; }
+                break;
+            case 'j': // worker threads
+                jobs = atoi(optarg);
+                if (jobs <= 0) { jobs = std::max(1u, thread::hardware_concurrency()); }
+                break;
+            case 'Q': // NCQ queue depth
+                queue_depth = atoi(optarg);
+                if (queue_depth <= 0) { cerr << "Error: Queue depth must be positive." << endl; return 1; }
+                break;
+            case 'R': // time units per platter revolution (NCQ model)
+                rotation_period = atoi(optarg);
+                if (rotation_period <= 0) { cerr << "Error: Rotation period must be positive." << endl; return 1; }
+                break;
+            case 'e': // deadline expiry
+                deadline_expire = atoi(optarg);
+                if (deadline_expire <= 0) { cerr << "Error: Deadline expiry must be positive." << endl; return 1; }
+                break;
+            case 'b': // fair-queueing budget
+                bfq_budget = atoi(optarg);
+                if (bfq_budget <= 0) { cerr << "Error: Budget must be positive." << endl; return 1; }
+                break;
+            case 'w': // adaptive scheduler window
+                adapt_window = atoi(optarg);
+                if (adapt_window <= 0) { cerr << "Error: Window must be positive." << endl; return 1; }
+                break;
+            case 'X': // replay on a real file or device
+                replay_target = optarg;
+                record_dispatch = true;
+                break;
+            case 'K': // replay queue depth
+                replay_depth = atoi(optarg);
+                if (replay_depth <= 0) { cerr << "Error: Replay queue depth must be positive." << endl; return 1; }
+                break;
+            case 'O': // O_DIRECT replay
+                replay_direct = true;
+                break;
+            case 'B': // submission front-end benchmark
+                bench_producers = std::min(64, std::max(1, atoi(optarg)));
+                break;
+            case 'U': // add() vs add_batch() benchmark over all schedulers
+                bench_burst = std::max(1, atoi(optarg));
+                break;
+            case 'Y': // get_next() cost vs queue depth over all schedulers
+                bench_depth = std::max(1, atoi(optarg));
+                break;
+            case 'M': // request merging
+                merge_requests = true;
+                break;
+            case 'P': // percentiles
+                print_percentiles = true;
+                break;
+            case 'H': // histogram dump
+                histogram_file = optarg;
+                break;
+            case 'g': // synthetic workload instead of an input file
+                workload_spec = optarg;
+                break;
+            case 'E': // print the synthetic workload and exit
+                emit = true;
+                break;
+            case 'c': // compare schedulers over one parse
+                compare_spec = optarg;
+                break;
+            case 'T': // per-tenant report
+                tenant_report = true;
+                break;
+            case 'm': // seek model
+                seek_spec = optarg;
+                break;
+            case 'C': // checkpoint file
+                checkpoint_file = optarg;
+                break;
+            case 'I': // checkpoint interval in time units
+                checkpoint_every = atoi(optarg);
+                if (checkpoint_every <= 0) { cerr << "Error: Checkpoint interval must be positive." << endl; return 1; }
+                break;
+            case 'L': // resume from a checkpoint
+                restore_file = optarg;
                 break;
             default:
                 cerr << "Error: Unknown option specified." << endl;
@@ -681,38 +2633,63 @@ int main(int argc, char* argv[]) {
         }
     }
 
+    if (!checkpoint_file.empty() && checkpoint_every == 0) { std::cerr << "Error: -C needs a checkpoint interval (-I)." << std::endl; return 1; }
+
     if (optind < argc) { inputfile = argv[optind]; } 
-    else { std::cerr << "Error: No input file specified." << std::endl; return 1;}
+    else if (bench_producers == 0 && bench_burst == 0 && bench_depth == 0 && workload_spec.empty()) { std::cerr << "Error: No input file specified." << std::endl; return 1;}
 
-    log(std::string("Initializing scheduler with algorithm: ") + alg);
-    switch (alg) {
-        case 'N':
-            sch = new FIFOSched();
-            break;
-        case 'S':
-            sch = new SSTFSched();
-            break;
-        case 'L':
-            sch = new LOOKSched();
-            break;
-        case 'C':
-            sch = new CLOOKSched();
-            break;
-        case 'F':
-            sch = new FLOOKSched();
-            break;
-        default:
-            std::cerr << "Error: Invalid scheduler algorithm specified." << std::endl;
-            return 1;
+    if (emit) {
+        if (workload_spec.empty()) { std::cerr << "Error: -E needs a workload (-g)." << std::endl; return 1; }
+        emit_workload(workload_spec);
+        return 0;
+    }
+
+    if (bench_burst > 0 || bench_depth > 0) {
+        seek_model = make_seek_model(seek_spec);
+        if (seek_model == nullptr) { return 1; }
+        if (bench_burst > 0) { run_batch_benchmark(bench_burst); }
+        if (bench_depth > 0) { run_get_next_benchmark(bench_depth); }
+        delete seek_model;
+        return 0;
+    }
+
+    if (!compare_spec.empty()) {
+        vector<Variant> variants;
+        if (!parse_variants(compare_spec, variants)) { return 1; }
+        seek_model = make_seek_model(seek_spec);
+        if (seek_model == nullptr) { return 1; }
+        if (!workload_spec.empty()) { generate_input(workload_spec); } else { read_input_file(inputfile); }
+        run_comparison(variants, jobs);
+        delete seek_model;
+        return 0;
+    }
+
+    if (string("NSLCFDBA").find(alg) == string::npos || alg == '\0') {
+        std::cerr << "Error: Invalid scheduler algorithm specified." << std::endl;
+        return 1;
+    }
+
+    seek_model = make_seek_model(seek_spec);
+    if (seek_model == nullptr) { return 1; }
+
+    if (bench_producers > 0) {
+        run_submission_benchmark(alg, bench_producers);
+        delete seek_model;
+        return 0;
     }
 
     // simulation
-    read_input_file(inputfile); 
-    simulation();               
+    if (!workload_spec.empty()) { generate_input(workload_spec); } else { read_input_file(inputfile); }
+    LOG(std::string("Initializing schedulers with algorithm: ") + alg);
+    for (Device& dev : devices) { dev.sch = make_scheduler(alg, dev); }
+    string fingerprint = snapshot_fingerprint(alg, workload_spec.empty() ? Snapshot::file_identity(inputfile) : "-g" + workload_spec, seek_spec);
+    if (!restore_file.empty()) { restore_devices(fingerprint); }
+    run_devices(jobs, fingerprint);
+    if (!replay_target.empty()) { replay_ok = replay_on_target(); }
     print_summary();            
 
     // clean up
-    delete sch;
-    return 0;
+    for (Device& dev : devices) { delete dev.sch; }
+    delete seek_model;
+    return replay_ok ? 0 : 1;
 }
-
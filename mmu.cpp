@@ -8,6 +8,11 @@
 #include <getopt.h>
 #include "bithacks.h"
 #include <climits>
+#include <cstring>
+#include <unistd.h>
+#include <fcntl.h>
+#include "workload.h"
+#include "snapshot.h"
 
 using namespace std;
 
@@ -19,7 +24,7 @@ const int PTE_ENTRIES = 64;
 int MAX_NUM_FRAMES = 128;         
 
 deque<int> free_frames;
-int instruction_counter = 0;
+unsigned long long instruction_counter = 0;
 int current_process_number = 0;
 
 const unsigned long long COST_READ_WRITE = 1;
@@ -113,13 +118,26 @@ struct Config {
     bool S_option = false;  
     string input_file;      
     string rand_file;
+    string trace_file;      // t: text trace goes here instead of stdout
+    string binlog_file;     // b: compact binary event log
+    string decode_file;     // D: pretty-print a binary event log and exit
+    string profile_file;    // p: JSON pager profile (MMU_PROFILE builds only)
+    unsigned long long tau = 49;                // T: WorkingSet pager window
+    string wss_file;                            // W: working set timeline (CSV)
+    vector<unsigned long long> wss_taus;        // w: taus tracked in the timeline, default {tau}
+    unsigned long long wss_interval = 1000;     // k: sample every k instructions
+    string workload;        // g: synthetic workload spec instead of an input file
+    bool emit = false;      // E: print the synthetic workload as an input file and exit
+    string checkpoint_file;                     // C: snapshot written every checkpoint_every instructions
+    unsigned long long checkpoint_every = 0;    // I
+    string restore_file;                        // L: resume from a snapshot
 };
 
 // command line arguments
 Config parse_commands(int argc, char* argv[]) {
     Config config;
     int c;
-    while ((c = getopt(argc, argv, "f:a:o:")) != -1) {
+    while ((c = getopt(argc, argv, "f:a:o:t:b:D:p:T:W:w:k:g:EC:I:L:")) != -1) {
         switch (c) {
             case 'f':
                 config.num_frames = stoi(optarg);
@@ -141,10 +159,51 @@ Config parse_commands(int argc, char* argv[]) {
                         default:  cerr << "Invalid option: " << opt << endl; exit(1);
                     }
                 } break;
+            case 't': config.trace_file = optarg; config.O_option = true; break;
+            case 'b': config.binlog_file = optarg; break;
+            case 'D': config.decode_file = optarg; break;
+            case 'p': config.profile_file = optarg; break;
+            case 'T':
+                config.tau = stoull(optarg);
+                if (config.tau == 0) { cerr << "Invalid tau. Must be positive" << endl; exit(1); }
+                break;
+            case 'W': config.wss_file = optarg; break;
+            case 'w': {
+                istringstream iss(optarg);
+                string tok;
+                while (getline(iss, tok, ',')) {
+                    unsigned long long tau = stoull(tok);
+                    if (tau == 0) { cerr << "Invalid tau. Must be positive" << endl; exit(1); }
+                    config.wss_taus.push_back(tau);
+                }
+            } break;
+            case 'k':
+                config.wss_interval = stoull(optarg);
+                if (config.wss_interval == 0) { cerr << "Invalid sample interval. Must be positive" << endl; exit(1); }
+                break;
+            case 'g': config.workload = optarg; break;
+            case 'E': config.emit = true; break;
+            case 'C': config.checkpoint_file = optarg; break;
+            case 'I':
+                config.checkpoint_every = stoull(optarg);
+                if (config.checkpoint_every == 0) { cerr << "Invalid checkpoint interval. Must be positive" << endl; exit(1); }
+                break;
+            case 'L': config.restore_file = optarg; break;
             default:
-                cerr << "Usage: " << argv[0] << " -f<num_frames> -a<algo> [-o<options>] inputfile randfile" << endl; exit(1);
+                cerr << "Usage: " << argv[0] << " -f<num_frames> -a<algo> [-o<options>] [-t<tracefile>] [-b<binlog>]" << endl;
+                cerr << "       [-T<tau>] [-W<wssfile> [-w<tau,...>] [-k<interval>]] inputfile randfile" << endl;
+                cerr << "       " << argv[0] << " -D<binlog> [-t<tracefile>]" << endl;
+                cerr << "       " << argv[0] << " -g<workload> [-E] [options] [randfile]" << endl;
+                cerr << "       checkpointing: [-C<snapshot> -I<every>] [-L<snapshot>]" << endl; exit(1);
         }
     }
+    if (!config.checkpoint_file.empty() && config.checkpoint_every == 0) { cerr << "-C needs an interval (-I)" << endl; exit(1); }
+    if (!config.decode_file.empty()) { return config; }
+    if (!config.workload.empty()) {   // generated input; without a randfile the random values are generated too
+        if (optind < argc) config.rand_file = argv[optind];
+        return config;
+    }
+    if (config.emit) { cerr << "-E needs a workload (-g)" << endl; exit(1); }
     
     if (optind + 2 > argc) { cerr << "Missing input or random file" << endl; exit(1); }
     
@@ -192,11 +251,21 @@ void parse_input_file(const string& filename) {
 }
 
 
-class InstructionReader {
+class InstructionSource {
+    public:
+        virtual ~InstructionSource() {}
+        virtual bool get_next_instruction(char& operation, int& vpage) = 0;
+        virtual void mark() {}                      // called before the snapshot fork, in the parent
+        virtual void save(Snapshot& snap) = 0;    // read position, for checkpoints
+        virtual void load(Snapshot& snap) = 0;
+};
+
+class InstructionReader : public InstructionSource {
     private:
         ifstream infile;
         string line;
         bool instruction_section_started = false;
+        long long marked = 0;   // read position at the last mark()
 
     public:
         InstructionReader(const string& filename) {
@@ -207,7 +276,7 @@ class InstructionReader {
             }
         }
 
-        bool get_next_instruction(char& operation, int& vpage) {
+        bool get_next_instruction(char& operation, int& vpage) override {
             while (getline(infile, line)) {
                 if (!instruction_section_started) {
                     if (line == "#### instruction simulation ######") { instruction_section_started = true; }  continue; 
@@ -223,13 +292,129 @@ class InstructionReader {
             return false;
         }
 
-        ~InstructionReader() {
+        // tellg() asks the kernel for the file offset, which the snapshot child shares with the
+        // parent as it reads on, so the position is taken before the fork
+        void mark() override { marked = (long long)infile.tellg(); }
+        void save(Snapshot& snap) override {
+            snap.put(instruction_section_started);
+            snap.put(marked);
+        }
+        void load(Snapshot& snap) override {
+            snap.get(instruction_section_started);
+            infile.clear();
+            infile.seekg(snap.get<long long>());
+        }
+
+        ~InstructionReader() override {
             if (infile.is_open()) {
                 infile.close();
             }
         }
 };
 
+/*
+    Synthetic workload (-g<spec>): processes, VMAs and the instruction stream are generated in
+    memory and fed to the simulator directly. Keys (see workload.h for the distributions):
+        n=1000000       instructions, context switches and exits included
+        seed=1
+        procs=4, vmas=4         each process's 64 pages are cut into this many VMAs
+        wp=0.1, fm=0.25         fraction of write-protected / file-mapped VMAs
+        dist=uniform|zipf|seq, s=0.99 (zipf exponent), run=8 (mean sequential run)
+        write=0.3       fraction of references that are writes
+        ctx=0.01, exit=0        per-instruction probability of a context switch / process exit
+    Every process draws pages from its own sampler. The stream ends early once all processes
+    have exited. -E prints the workload as an input file instead of simulating it.
+*/
+class WorkloadGenerator : public InstructionSource {
+    private:
+        WorkloadSpec spec;
+        WorkloadRng rng;
+        vector<LocationSampler> samplers;
+        vector<int> live;
+        unsigned long long remaining;
+        double write_ratio, ctx_rate, exit_rate;
+        int current = -1;
+
+    public:
+        explicit WorkloadGenerator(const string& text) : spec(text), rng((uint64_t)spec.get("seed", 1LL)) {
+            remaining = (unsigned long long)spec.get("n", 1000000LL);
+            int procs = (int)spec.get("procs", 4LL);
+            int vmas = (int)spec.get("vmas", 4LL);
+            double wp = spec.get("wp", 0.1), fm = spec.get("fm", 0.25);
+            string dist = spec.get("dist", string("uniform"));
+            double s = spec.get("s", 0.99), run = spec.get("run", 8.0);
+            write_ratio = spec.get("write", 0.3);
+            ctx_rate = spec.get("ctx", 0.01);
+            exit_rate = spec.get("exit", 0.0);
+            spec.check();
+            if (procs <= 0 || vmas <= 0 || vmas > PTE_ENTRIES) { cerr << "Invalid workload: procs must be positive, vmas between 1 and 64" << endl; exit(1); }
+
+            for (int pid = 0; pid < procs; pid++) {
+                Process proc(pid);
+                vector<int> cuts;   // vmas - 1 distinct cut points in 1..63
+                for (int page = 1; page < PTE_ENTRIES && (int)cuts.size() < vmas - 1; page++) {
+                    if (rng.below(PTE_ENTRIES - page) < (uint64_t)(vmas - 1 - (int)cuts.size())) cuts.push_back(page);
+                }
+                cuts.push_back(PTE_ENTRIES);
+                int start = 0;
+                for (int end : cuts) {
+                    proc.vmas.emplace_back(start, end - 1, rng.chance(wp), rng.chance(fm));
+                    start = end;
+                }
+                processes.push_back(proc);
+                samplers.emplace_back(dist, PTE_ENTRIES, s, run, rng);
+                live.push_back(pid);
+            }
+        }
+
+        bool get_next_instruction(char& operation, int& vpage) override {
+            if (remaining == 0 || live.empty()) return false;
+            remaining--;
+            if (current < 0 || (live.size() > 1 && rng.chance(ctx_rate))) {
+                int next = live[rng.below(live.size())];
+                while (next == current && live.size() > 1) next = live[rng.below(live.size())];
+                current = next;
+                operation = 'c'; vpage = current;
+                return true;
+            }
+            if (rng.chance(exit_rate)) {
+                for (size_t i = 0; i < live.size(); i++) {
+                    if (live[i] == current) { live.erase(live.begin() + i); break; }
+                }
+                operation = 'e'; vpage = current;
+                current = -1;   // the next instruction switches to a live process
+                return true;
+            }
+            operation = rng.chance(write_ratio) ? 'w' : 'r';
+            vpage = (int)samplers[current].sample(rng);
+            return true;
+        }
+
+        void save(Snapshot& snap) override {
+            uint64_t state[4];
+            rng.get_state(state);
+            snap.put(state);
+            snap.put(remaining);
+            snap.put(current);
+            snap.put_vector(live);
+            for (const LocationSampler& sampler : samplers) snap.put(sampler.cursor());
+        }
+        void load(Snapshot& snap) override {
+            uint64_t state[4];
+            snap.get(state);
+            rng.set_state(state);
+            snap.get(remaining);
+            snap.get(current);
+            snap.get_vector(live);
+            for (LocationSampler& sampler : samplers) sampler.set_cursor(snap.get<uint64_t>());
+        }
+
+        // random values for the Random pager when no randfile is given
+        void fill_random_values(vector<int>& values, size_t count) {
+            WorkloadRng r(rng.next());
+            for (size_t i = 0; i < count; i++) values.push_back((int)(r.next() >> 33));
+        }
+};
 
 //------------------------------------------ PRINT FUNCTIONS -----------------------------------------------
 
@@ -271,12 +456,459 @@ void print_frame_table() {
 //     printf("\n");
 // }
 
+//------------------------------------------ TRACE OUTPUT --------------------------------------------------
+
+/*
+    -oO event trace. Text lines are formatted by hand into a large buffer and written with one
+    write() per buffer instead of one printf per event. With -b the same events are also written
+    as a compact binary log: one tag byte per event plus zigzag varints for its arguments
+    (instruction numbers are implicit, they are counted back when decoding). -D turns a binary
+    log back into exactly the text -oO would have printed.
+*/
+enum TraceEvent : unsigned char {
+    EV_INSTR, EV_EXIT, EV_UNMAP, EV_MAP, EV_OUT, EV_FOUT, EV_IN, EV_FIN, EV_ZERO, EV_SEGV, EV_SEGPROT
+};
+static const char* const EVENT_TEXT[] = {
+    "", "", "", "", " OUT\n", " FOUT\n", " IN\n", " FIN\n", " ZERO\n", " SEGV\n", " SEGPROT\n"
+};
+static const char BINLOG_MAGIC[8] = { 'M', 'M', 'U', 'T', 'R', 'C', '1', '\n' };
+
+class BufferedFile {
+    private:
+        static const size_t BUF_SIZE = 1 << 20;
+        static const size_t MAX_RECORD = 64;   // longest single record we ever append
+        char* buf = nullptr;
+        size_t len = 0;
+        int fd = -1;
+        bool owns_fd = false;
+        unsigned long long written = 0;    // bytes already handed to write()
+
+    public:
+        ~BufferedFile() { close(); }
+
+        void open_fd(int f) { fd = f; owns_fd = false; if (!buf) buf = new char[BUF_SIZE]; }
+        void open_path(const string& path) {
+            int f = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+            if (f < 0) { cerr << "Cannot open output file: " << path << endl; exit(1); }
+            open_fd(f); owns_fd = true;
+        }
+        // reopen a file a snapshot was taken of, dropping whatever was written after it
+        void open_path_at(const string& path, unsigned long long offset) {
+            int f = ::open(path.c_str(), O_WRONLY | O_CREAT, 0644);
+            if (f < 0 || ftruncate(f, offset) != 0 || lseek(f, offset, SEEK_SET) < 0) {
+                cerr << "Cannot reopen output file: " << path << endl; exit(1);
+            }
+            open_fd(f); owns_fd = true; written = offset;
+        }
+        void set_offset(unsigned long long offset) { written = offset; }
+        unsigned long long offset() const { return written + len; }
+        bool is_open() const { return fd >= 0; }
+
+        void flush() {
+            size_t off = 0;
+            while (off < len) {
+                ssize_t n = ::write(fd, buf + off, len - off);
+                if (n <= 0) { cerr << "Error: trace write failed" << endl; exit(1); }
+                off += n;
+            }
+            written += len;
+            len = 0;
+        }
+        void close() {
+            if (fd < 0) return;
+            flush();
+            if (owns_fd) ::close(fd);
+            fd = -1;
+            delete[] buf; buf = nullptr;
+        }
+
+        // every record starts by reserving room, so the put_* calls never check for overflow
+        void reserve() { if (len + MAX_RECORD > BUF_SIZE) flush(); }
+
+        void put_char(char c) { buf[len++] = c; }
+        void put_str(const char* s) { while (*s) buf[len++] = *s++; }
+        void put_bytes(const char* s, size_t n) { memcpy(buf + len, s, n); len += n; }
+        void put_int(long long v) {
+            char tmp[24];
+            int n = 0;
+            unsigned long long u = v < 0 ? 0ULL - (unsigned long long)v : (unsigned long long)v;
+            do { tmp[n++] = '0' + u % 10; u /= 10; } while (u);
+            if (v < 0) buf[len++] = '-';
+            while (n) buf[len++] = tmp[--n];
+        }
+        void put_varint(long long v) {
+            unsigned long long u = ((unsigned long long)v << 1) ^ (unsigned long long)(v >> 63);
+            while (u >= 0x80) { buf[len++] = (char)(u | 0x80); u >>= 7; }
+            buf[len++] = (char)u;
+        }
+};
+
+class TraceWriter {
+    private:
+        BufferedFile text;
+        BufferedFile binary;
+
+        void text_event(TraceEvent ev, long long instr, int a, int b) {
+            text.reserve();
+            switch (ev) {
+                case EV_INSTR:
+                    text.put_int(instr); text.put_str(": ==> "); text.put_char((char)a);
+                    text.put_char(' '); text.put_int(b); text.put_char('\n'); break;
+                case EV_EXIT:
+                    text.put_str("EXIT current process "); text.put_int(a); text.put_char('\n'); break;
+                case EV_UNMAP:
+                    text.put_str(" UNMAP "); text.put_int(a); text.put_char(':'); text.put_int(b); text.put_char('\n'); break;
+                case EV_MAP:
+                    text.put_str(" MAP "); text.put_int(a); text.put_char('\n'); break;
+                default:
+                    text.put_str(EVENT_TEXT[ev]); break;
+            }
+        }
+        void record(TraceEvent ev, long long instr, int a = 0, int b = 0) {
+            if (text.is_open()) { text_event(ev, instr, a, b); }
+            if (binary.is_open()) {
+                binary.reserve();
+                binary.put_char((char)ev);
+                switch (ev) {
+                    case EV_INSTR: binary.put_char((char)a); binary.put_varint(b); break;
+                    case EV_EXIT: case EV_MAP: binary.put_varint(a); break;
+                    case EV_UNMAP: binary.put_varint(a); binary.put_varint(b); break;
+                    default: break;
+                }
+            }
+        }
+
+    public:
+        bool active = false;    // any sink open; call sites test this before building an event
+
+        void open(const Config& config) {
+            if (config.O_option) {
+                if (config.trace_file.empty()) text.open_fd(STDOUT_FILENO);
+                else text.open_path(config.trace_file);
+            }
+            if (!config.binlog_file.empty()) {
+                binary.open_path(config.binlog_file);
+                binary.reserve();
+                binary.put_bytes(BINLOG_MAGIC, sizeof(BINLOG_MAGIC));
+            }
+            active = text.is_open() || binary.is_open();
+        }
+        void close() { text.close(); binary.close(); active = false; }
+
+        // checkpoints flush first, so the offsets saved are what is on disk
+        void flush() { if (text.is_open()) text.flush(); if (binary.is_open()) binary.flush(); }
+        void save(Snapshot& snap) const { snap.put(text.offset()); snap.put(binary.offset()); }
+        void resume(const Config& config, Snapshot& snap) {
+            unsigned long long text_offset = snap.get<unsigned long long>();
+            unsigned long long binary_offset = snap.get<unsigned long long>();
+            if (config.O_option) {
+                if (config.trace_file.empty()) { text.open_fd(STDOUT_FILENO); text.set_offset(text_offset); }
+                else text.open_path_at(config.trace_file, text_offset);
+            }
+            if (!config.binlog_file.empty()) binary.open_path_at(config.binlog_file, binary_offset);
+            active = text.is_open() || binary.is_open();
+        }
+
+        void instr(long long n, char op, int vpage) { if (active) record(EV_INSTR, n, op, vpage); }
+        void exit_proc(int pid)               { if (active) record(EV_EXIT, 0, pid); }
+        void unmap(int pid, int vpage)        { if (active) record(EV_UNMAP, 0, pid, vpage); }
+        void map(int frame)                   { if (active) record(EV_MAP, 0, frame); }
+        void event(TraceEvent ev)             { if (active) record(ev, 0); }
+
+        // offline pretty-printer for a -b log
+        static void decode(const string& binlog, const string& out_file) {
+            ifstream in(binlog, ios::binary);
+            if (!in.is_open()) { cerr << "Cannot open binary log: " << binlog << endl; exit(1); }
+            vector<char> data((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+            if (data.size() < sizeof(BINLOG_MAGIC) || memcmp(data.data(), BINLOG_MAGIC, sizeof(BINLOG_MAGIC)) != 0) {
+                cerr << "Error: " << binlog << " is not an mmu binary log" << endl; exit(1);
+            }
+            TraceWriter tw;
+            if (out_file.empty()) tw.text.open_fd(STDOUT_FILENO);
+            else tw.text.open_path(out_file);
+
+            size_t pos = sizeof(BINLOG_MAGIC);
+            auto varint = [&]() -> long long {
+                unsigned long long u = 0;
+                for (int shift = 0; pos < data.size(); shift += 7) {
+                    unsigned char byte = data[pos++];
+                    u |= (unsigned long long)(byte & 0x7f) << shift;
+                    if (!(byte & 0x80)) return (long long)(u >> 1) ^ -(long long)(u & 1);
+                }
+                cerr << "Error: truncated binary log" << endl; exit(1);
+            };
+            long long instr_no = 0;
+            while (pos < data.size()) {
+                TraceEvent ev = (TraceEvent)data[pos++];
+                int a = 0, b = 0;
+                switch (ev) {
+                    case EV_INSTR:
+                        if (pos >= data.size()) { cerr << "Error: truncated binary log" << endl; exit(1); }
+                        a = data[pos++]; b = varint(); break;
+                    case EV_EXIT: case EV_MAP: a = varint(); break;
+                    case EV_UNMAP: a = varint(); b = varint(); break;
+                    case EV_OUT: case EV_FOUT: case EV_IN: case EV_FIN: case EV_ZERO: case EV_SEGV: case EV_SEGPROT: break;
+                    default: cerr << "Error: bad event tag in binary log" << endl; exit(1);
+                }
+                tw.text_event(ev, instr_no, a, b);
+                if (ev == EV_INSTR) instr_no++;
+            }
+            tw.close();
+        }
+};
+
+TraceWriter trace;
+
+//------------------------------------------ PAGER PROFILING -----------------------------------------------
+
+/*
+    Build with -DMMU_PROFILE to time every select_victim_frame() call (rdtsc cycles) and count
+    how many frames each call examines. "sweep" is the per-policy bookkeeping pass: R bits
+    cleared by the Clock second-chance sweep, frames aged by Aging, frames whose R bit the NRU
+    reset touched, R bits consumed by WorkingSet. Values go into log-linear (HDR-style) histograms, dumped as JSON at exit
+    to stderr or to the -p<file>. Without MMU_PROFILE the hooks below compile to nothing.
+*/
+#ifdef MMU_PROFILE
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+static inline unsigned long long read_cycles() { return __rdtsc(); }
+#else
+#include <chrono>
+static inline unsigned long long read_cycles() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+#endif
+
+// values below 2*SUB_BUCKETS are exact, above that each power of two is split into SUB_BUCKETS
+class LatencyHistogram {
+    private:
+        static const int SUB_BITS = 4;
+        static const int SUB_BUCKETS = 1 << SUB_BITS;
+        static const int NUM_BUCKETS = (65 - SUB_BITS) * SUB_BUCKETS;   // bucket_of(ULLONG_MAX) is the last
+        unsigned long long buckets[NUM_BUCKETS] = {};
+        unsigned long long count = 0, total = 0, min_v = ULLONG_MAX, max_v = 0;
+
+        static int bucket_of(unsigned long long v) {
+            if (v < 2 * SUB_BUCKETS) return (int)v;
+            int e = 63 - __builtin_clzll(v) - SUB_BITS;
+            return e * SUB_BUCKETS + (int)(v >> e);
+        }
+        static unsigned long long bucket_low(int b) {
+            if (b < 2 * SUB_BUCKETS) return b;
+            int e = b / SUB_BUCKETS - 1;
+            return (unsigned long long)(b % SUB_BUCKETS + SUB_BUCKETS) << e;
+        }
+
+    public:
+        void record(unsigned long long v) {
+            buckets[bucket_of(v)]++;
+            count++; total += v;
+            if (v < min_v) min_v = v;
+            if (v > max_v) max_v = v;
+        }
+        unsigned long long percentile(double p) const {
+            if (count == 0) return 0;
+            unsigned long long rank = (unsigned long long)(p / 100.0 * count);
+            if (rank >= count) rank = count - 1;
+            unsigned long long seen = 0;
+            for (int b = 0; b < NUM_BUCKETS; b++) {
+                seen += buckets[b];
+                if (seen > rank) return min(max(bucket_low(b), min_v), max_v);
+            }
+            return max_v;
+        }
+        void to_json(FILE* out, const char* name) const {
+            fprintf(out, "    \"%s\": {\"count\": %llu, \"min\": %llu, \"max\": %llu, \"mean\": %.2f, "
+                         "\"p50\": %llu, \"p90\": %llu, \"p99\": %llu, \"p999\": %llu, \"buckets\": [",
+                    name, count, count ? min_v : 0, max_v, count ? (double)total / count : 0.0,
+                    percentile(50), percentile(90), percentile(99), percentile(99.9));
+            bool first = true;
+            for (int b = 0; b < NUM_BUCKETS; b++) {
+                if (!buckets[b]) continue;
+                fprintf(out, "%s[%llu, %llu]", first ? "" : ", ", bucket_low(b), buckets[b]);
+                first = false;
+            }
+            fprintf(out, "]}");
+        }
+};
+
+struct PagerProfile {
+    LatencyHistogram select_cycles;
+    LatencyHistogram frames_scanned;
+    LatencyHistogram sweep_len;
+    unsigned long long scanned = 0;   // per-call counters, folded into the histograms by end()
+    unsigned long long swept = 0;
+    unsigned long long started = 0;
+
+    void begin() { scanned = swept = 0; started = read_cycles(); }
+    void end() {
+        unsigned long long now = read_cycles();
+        if (now >= started) select_cycles.record(now - started);   // the counter can step back across cpus
+        frames_scanned.record(scanned);
+        sweep_len.record(swept);
+    }
+    void write_json(const string& path, char algo, int num_frames) const {
+        FILE* out = path.empty() ? stderr : fopen(path.c_str(), "w");
+        if (!out) { cerr << "Cannot open profile output file: " << path << endl; exit(1); }
+        fprintf(out, "{\n  \"pager\": \"%c\",\n  \"frames\": %d,\n  \"histograms\": {\n", algo, num_frames);
+        select_cycles.to_json(out, "select_cycles");   fprintf(out, ",\n");
+        frames_scanned.to_json(out, "frames_scanned"); fprintf(out, ",\n");
+        sweep_len.to_json(out, "sweep_len");           fprintf(out, "\n  }\n}\n");
+        if (out != stderr) fclose(out);
+    }
+};
+PagerProfile pager_profile;
+
+#define PROFILE_SELECT_BEGIN() pager_profile.begin()
+#define PROFILE_SELECT_END()   pager_profile.end()
+#define PROFILE_SCAN()         (pager_profile.scanned++)
+#define PROFILE_SWEEP(n)       (pager_profile.swept += (n))
+#else
+#define PROFILE_SELECT_BEGIN() ((void)0)
+#define PROFILE_SELECT_END()   ((void)0)
+#define PROFILE_SCAN()         ((void)0)
+#define PROFILE_SWEEP(n)       ((void)0)
+#endif
+
+//------------------------------------------ WORKING SET TIMELINE ------------------------------------------
+
+/*
+    -W<file> writes a CSV timeline with, every -k<K> instructions, each process' resident set
+    size and its working set size WSS(t, tau) for every tau in -w<tau,tau,...>.
+    WSS is kept incrementally: a ring of the last max(tau) references plus each page's last
+    reference time. At time t the reference made at t - tau leaves the window of that tau, and
+    it only drops the page if it was still the page's latest reference. Cost per instruction is
+    O(number of taus), independent of page table size and of how long the trace is.
+*/
+class WSSTracker {
+    private:
+        struct Ref { int pid; int vpage; };
+        vector<unsigned long long> taus;
+        unsigned long long interval = 1000;
+        unsigned long long last_sample = 0;
+        vector<Ref> ring;                          // reference made at time t lives in ring[t % ring.size()]
+        vector<unsigned long long> last_ref;       // [pid * PTE_ENTRIES + vpage], 0 = not referenced
+        vector<unsigned long long> wss;            // [pid * taus.size() + k]
+        vector<long long> rss;                     // [pid]
+        BufferedFile out;
+
+        void sample(unsigned long long t) {
+            out.reserve(); out.put_int(t);
+            for (size_t pid = 0; pid < rss.size(); pid++) {
+                out.reserve(); out.put_char(','); out.put_int(rss[pid]);
+                for (size_t k = 0; k < taus.size(); k++) {
+                    out.reserve(); out.put_char(','); out.put_int(wss[pid * taus.size() + k]);
+                }
+            }
+            out.put_char('\n');
+            last_sample = t;
+        }
+
+    public:
+        bool enabled = false;
+
+        void open(const Config& config, int num_processes) {
+            if (config.wss_file.empty()) return;
+            setup(config, num_processes);
+            out.open_path(config.wss_file);
+            out.reserve(); out.put_str("instr");
+            for (int pid = 0; pid < num_processes; pid++) {
+                out.reserve(); out.put_str(",p"); out.put_int(pid); out.put_str("_rss");
+                for (unsigned long long tau : taus) {
+                    out.reserve(); out.put_str(",p"); out.put_int(pid); out.put_str("_wss"); out.put_int(tau);
+                }
+            }
+            out.put_char('\n');
+            enabled = true;
+        }
+
+        void flush() { if (enabled) out.flush(); }
+        void save(Snapshot& snap) const {
+            if (!enabled) return;
+            snap.put(last_sample);
+            snap.put_vector(ring);
+            snap.put_vector(last_ref);
+            snap.put_vector(wss);
+            snap.put_vector(rss);
+            snap.put(out.offset());
+        }
+        void resume(const Config& config, int num_processes, Snapshot& snap) {
+            if (config.wss_file.empty()) return;
+            setup(config, num_processes);
+            snap.get(last_sample);
+            snap.get_vector(ring);
+            snap.get_vector(last_ref);
+            snap.get_vector(wss);
+            snap.get_vector(rss);
+            out.open_path_at(config.wss_file, snap.get<unsigned long long>());
+            enabled = true;
+        }
+
+    private:
+        void setup(const Config& config, int num_processes) {
+            taus = config.wss_taus;
+            if (taus.empty()) taus.push_back(config.tau);
+            interval = config.wss_interval;
+            unsigned long long max_tau = 0;
+            for (unsigned long long tau : taus) max_tau = max(max_tau, tau);
+            ring.assign(max_tau + 1, Ref{-1, -1});
+            last_ref.assign((size_t)num_processes * PTE_ENTRIES, 0);
+            wss.assign((size_t)num_processes * taus.size(), 0);
+            rss.assign(num_processes, 0);
+        }
+
+    public:
+        // start of instruction t (1-based): emit due sample, then age every window by one step
+        void tick(unsigned long long t) {
+            if (t > 1 && (t - 1) % interval == 0) sample(t - 1);
+            for (size_t k = 0; k < taus.size(); k++) {
+                if (t <= taus[k]) continue;
+                unsigned long long gone = t - taus[k];
+                const Ref& r = ring[gone % ring.size()];
+                if (r.pid >= 0 && last_ref[r.pid * PTE_ENTRIES + r.vpage] == gone) {
+                    wss[r.pid * taus.size() + k]--;
+                }
+            }
+            ring[t % ring.size()] = Ref{-1, -1};
+        }
+
+        void reference(int pid, int vpage, unsigned long long t) {
+            unsigned long long& last = last_ref[pid * PTE_ENTRIES + vpage];
+            for (size_t k = 0; k < taus.size(); k++) {
+                if (last == 0 || last + taus[k] <= t) wss[pid * taus.size() + k]++;
+            }
+            last = t;
+            ring[t % ring.size()] = Ref{pid, vpage};
+        }
+
+        void map(int pid)   { rss[pid]++; }
+        void unmap(int pid) { rss[pid]--; }
+
+        void exit_proc(int pid) {
+            fill(last_ref.begin() + pid * PTE_ENTRIES, last_ref.begin() + (pid + 1) * PTE_ENTRIES, 0ULL);
+            fill(wss.begin() + pid * taus.size(), wss.begin() + (pid + 1) * taus.size(), 0ULL);
+        }
+
+        void close(unsigned long long t) {
+            if (!enabled) return;
+            if (t != last_sample) sample(t);
+            out.close();
+            enabled = false;
+        }
+};
+
+WSSTracker wss_tracker;
+
 //------------------------------------------ PAGER IMPLEMENTATIONS ---------------------------------------------------
 
 class Pager {
     public:
         virtual ~Pager() = default;
         virtual FTE* select_victim_frame() = 0;
+        // hands and timers for checkpoints; frame ages live in the frame table
+        virtual vector<unsigned long long> state() const { return {}; }
+        virtual void set_state(const vector<unsigned long long>& /*s*/) {}
 };
 
 class FIFO : public Pager {
@@ -284,9 +916,12 @@ class FIFO : public Pager {
     public:
         FTE* select_victim_frame() override {
             int victim = curr;
+            PROFILE_SCAN();
             curr = (curr + 1) % frame_table.size();
             return &frame_table[victim];
         }
+        vector<unsigned long long> state() const override { return { (unsigned long long)curr }; }
+        void set_state(const vector<unsigned long long>& s) override { curr = (int)s[0]; }
 };
 
 class Random : public Pager {
@@ -294,6 +929,7 @@ class Random : public Pager {
         Random() {} 
         FTE* select_victim_frame() override {
             int frame_idx = get_random_number(frame_table.size()); //between 0 to num_frames-1
+            PROFILE_SCAN();
             return &frame_table[frame_idx];
         }
 };
@@ -310,6 +946,7 @@ class Clock : public Pager {
             // until R=0 page found
             while (!found && frames_checked < frame_table.size()) {
                 FTE& current = frame_table[hand];          //frame 
+                PROFILE_SCAN();
                 Process& proc = processes[current.pid];    // frame ka process
                 PTE& pte = proc.page_table[current.vpage];  // frame ke process ka pafe
                 
@@ -317,7 +954,7 @@ class Clock : public Pager {
                     victim = &current;
                     found = true;
                 } 
-                else { pte.referenced = 0; } // give second chance -> clear R and move on
+                else { pte.referenced = 0; PROFILE_SWEEP(1); } // give second chance -> clear R and move on
                 hand = (hand + 1) % frame_table.size();
                 frames_checked++;
             }
@@ -325,10 +962,13 @@ class Clock : public Pager {
             // found no frame with ref=0 -> all pages get second chance
             if (!found) {
                 victim = &frame_table[hand];
+                PROFILE_SCAN();
                 hand = (hand + 1) % frame_table.size();
             }
             return victim;
         }
+        vector<unsigned long long> state() const override { return { (unsigned long long)hand }; }
+        void set_state(const vector<unsigned long long>& s) override { hand = (int)s[0]; }
 };
 
 class NRU : public Pager {
@@ -354,6 +994,7 @@ class NRU : public Pager {
                 if (frame_table[i].pid != -1) {
                     Process& proc = processes[frame_table[i].pid];
                     proc.page_table[frame_table[i].vpage].referenced = 0;
+                    PROFILE_SWEEP(1);
                 }
             }
             last_reset = instruction_counter;
@@ -369,6 +1010,7 @@ class NRU : public Pager {
             // classify all frames
             do {
                 FTE& frame = frame_table[curr];
+                PROFILE_SCAN();
                 if (frame.pid != -1) {
                     int class_num = get_class(frame);
                     if (class_num >= 0) { class_frames[class_num].push_back(&frame); }
@@ -388,6 +1030,8 @@ class NRU : public Pager {
             }
             return &frame_table[0]; // this should never happen if there are frames in use
         }
+        vector<unsigned long long> state() const override { return { (unsigned long long)curr, last_reset }; }
+        void set_state(const vector<unsigned long long>& s) override { curr = (int)s[0]; last_reset = s[1]; }
 };
 
 
@@ -405,12 +1049,14 @@ class Aging : public Pager {
             // age all pages and find victim with lowest bit count
             do {
                 FTE& current_frame = frame_table[hand];
+                PROFILE_SCAN();
                 if (current_frame.pid != -1) {
                     Process& proc = processes[current_frame.pid];
                     PTE& pte = proc.page_table[current_frame.vpage];
                     
                     // age the page
                     current_frame.age = current_frame.age >> 1;
+                    PROFILE_SWEEP(1);
                     if (pte.referenced) {
                         current_frame.age = current_frame.age | 0x80000000;
                     }
@@ -427,32 +1073,36 @@ class Aging : public Pager {
             if (victim) { hand = ((victim - &frame_table[0]) + 1) % frame_table.size(); }    
             return victim ? victim : &frame_table[start_hand];
         }
+        vector<unsigned long long> state() const override { return { (unsigned long long)hand }; }
+        void set_state(const vector<unsigned long long>& s) override { hand = (int)s[0]; }
 };
 
 class WorkingSet : public Pager {
     private:
         int hand;
-        const unsigned int TAU = 49;
+        const unsigned long long TAU;
     public:
-        WorkingSet() : hand(0) {}
+        WorkingSet(unsigned long long tau) : hand(0), TAU(tau) {}
         FTE* select_victim_frame() override {
             int start_hand = hand;
             FTE* oldest_frame = nullptr;
             unsigned int oldest_time = UINT_MAX;
             do {
                 FTE& current = frame_table[hand];
+                PROFILE_SCAN();
                 if (current.pid != -1) {
                     Process& proc = processes[current.pid];
                     PTE& pte = proc.page_table[current.vpage];
                     // victim = not referenced and outside window
-                    if (!pte.referenced && (instruction_counter - current.age > TAU)) {
+                    if (!pte.referenced && ((unsigned int)instruction_counter - current.age > TAU)) {
                         FTE* victim = &current;
                         hand = (hand + 1) % frame_table.size();
                         return victim;
                     }
                     if (pte.referenced) {
-                        current.age = instruction_counter;
+                        current.age = (unsigned int)instruction_counter;
                         pte.referenced = 0;
+                        PROFILE_SWEEP(1);
                     }
                     // track oldest frame as fallback
                     if (current.age < oldest_time) {
@@ -465,6 +1115,8 @@ class WorkingSet : public Pager {
             hand = (oldest_frame - &frame_table[0] + 1) % frame_table.size();
             return oldest_frame;
         }
+        vector<unsigned long long> state() const override { return { (unsigned long long)hand }; }
+        void set_state(const vector<unsigned long long>& s) override { hand = (int)s[0]; }
 };
 
 //------------------------------------------- HELPER FUNCTIONS -------------------------------------------------------
@@ -488,8 +1140,10 @@ void return_frame_to_freelist(int frame_num) {
     2. update page table of the removed frame's process
     3. OUT/FOUT
 */
-void handle_unmap(Pager* pager, const Config& config, unsigned long long& cost) {
+void handle_unmap(Pager* pager, unsigned long long& cost) {
+    PROFILE_SELECT_BEGIN();
     FTE* victim_frame = pager->select_victim_frame();
+    PROFILE_SELECT_END();
     // if (!victim_frame) return;
     
     //get victim
@@ -497,17 +1151,18 @@ void handle_unmap(Pager* pager, const Config& config, unsigned long long& cost)
     Process& old_proc = processes[victim_frame->pid];
     PTE& old_pte = old_proc.page_table[victim_frame->vpage];
     
-    if (config.O_option) { printf(" UNMAP %d:%d\n", victim_frame->pid, victim_frame->vpage); }
+    trace.unmap(victim_frame->pid, victim_frame->vpage);
     old_proc.unmaps++; cost += COST_UNMAP;
+    if (wss_tracker.enabled) wss_tracker.unmap(victim_frame->pid);
     
     // if page !modified, content in memory = disk : writing back would be unnecessary
     if (old_pte.modified) {
         const VMA* vma = check_vma_access(old_proc, victim_frame->vpage);
         if (vma && vma->file_mapped) {
-            if (config.O_option) printf(" FOUT\n");
+            trace.event(EV_FOUT);
             old_proc.fouts++; cost += COST_FOUT;
         } else {
-            if (config.O_option) printf(" OUT\n");
+            trace.event(EV_OUT);
             old_proc.outs++; cost += COST_OUT;
             old_pte.pagedout = 1;  // this page has been paged out
         }
@@ -527,7 +1182,7 @@ void handle_unmap(Pager* pager, const Config& config, unsigned long long& cost)
         -> calls handle_unmap to free a frame using the replacement algo
         -> get a free frame now
 */
-int allocate_frame(Pager* pager, const Config& config, unsigned long long& cost) {
+int allocate_frame(Pager* pager, unsigned long long& cost) {
     int frame_number;
     // chekc for free frame 
     if (!free_frames.empty()) {
@@ -536,7 +1191,7 @@ int allocate_frame(Pager* pager, const Config& config, unsigned long long& cost)
         return frame_number;
     }
     // no free frames - replacement algorithm
-    handle_unmap(pager, config, cost);  
+    handle_unmap(pager, cost);  
     if (!free_frames.empty()) {
         frame_number = free_frames.front();
         free_frames.pop_front();
@@ -555,16 +1210,16 @@ int allocate_frame(Pager* pager, const Config& config, unsigned long long& cost)
 void handle_page_fault(Process& proc, int vpage, const Config& config, Pager* pager, unsigned long long& cost) {
     const VMA* vma = check_vma_access(proc, vpage);
     if (!vma) {
-        if (config.O_option) printf(" SEGV\n");
+        trace.event(EV_SEGV);
         proc.segv++;
         return;
     }
     
-    int frame = allocate_frame(pager, config, cost);
+    int frame = allocate_frame(pager, cost);
     if (config.algo == 'a') {
         static_cast<Aging*>(pager)->reset_age(frame);
     }
-    frame_table[frame].age = instruction_counter;
+    frame_table[frame].age = (unsigned int)instruction_counter;
 
     // update pte
     PTE& pte = proc.page_table[vpage];
@@ -575,10 +1230,92 @@ void handle_page_fault(Process& proc, int vpage, const Config& config, Pager* pa
     frame_table[frame].pid = proc.pid;
     frame_table[frame].vpage = vpage;
     
-    if (pte.pagedout) { printf(" IN\n");  proc.ins++; } 
-    else if (vma->file_mapped) { printf(" FIN\n"); proc.fins++; } 
-    else { printf(" ZERO\n"); proc.zeros++; }
-    printf(" MAP %d\n", frame);  proc.maps++;
+    if (pte.pagedout) { trace.event(EV_IN);  proc.ins++; } 
+    else if (vma->file_mapped) { trace.event(EV_FIN); proc.fins++; } 
+    else { trace.event(EV_ZERO); proc.zeros++; }
+    trace.map(frame);  proc.maps++;
+    if (wss_tracker.enabled) wss_tracker.map(proc.pid);
+}
+
+//----------------------------------------------- CHECKPOINTS -------------------------------------------------------
+
+/*
+    -C<file> -I<n>: a snapshot (see snapshot.h) is written between instructions every n
+    instructions. It holds the frame table, free list, page tables and per-process counters
+    (VMAs come from the input again), the pager's hands and timers, the random index, the
+    input position, the running totals, and the working set tracker. -L<file> resumes from one. It needs the same inputs
+    and options (the snapshot refuses others) and finishes with the same results as the
+    uninterrupted run. Trace, binary log and WSS files are cut back to their length at the
+    snapshot and continued. The -oO trace on stdout simply continues from the snapshot point.
+    MMU_PROFILE counters are not saved.
+*/
+static const char MMU_SNAPSHOT_MAGIC[8] = { 'M', 'M', 'U', 'S', 'N', 'A', 'P', '1' };
+
+struct RunTotals {
+    unsigned long long cost = 0;  // 64-bit
+    unsigned long ctx_switches = 0;
+    unsigned long process_exits = 0;
+};
+
+string snapshot_fingerprint(const Config& config) {
+    ostringstream fp;
+    fp << config.algo << ' ' << config.num_frames << ' ' << config.tau << ' ' << config.O_option << ' '
+       << Snapshot::file_identity(config.input_file) << ' ' << Snapshot::file_identity(config.rand_file) << ' ' << config.workload << ' ' << config.trace_file << ' '
+       << config.binlog_file << ' ' << config.wss_file << ' ' << config.wss_interval;
+    for (unsigned long long tau : config.wss_taus) fp << ',' << tau;
+    return fp.str();
+}
+
+void save_checkpoint(const Config& config, Pager* pager, InstructionSource& reader, const RunTotals& totals, Snapshot& snap) {
+    trace.flush();
+    wss_tracker.flush();
+    reader.mark();
+    snap.write_in_background(config.checkpoint_file, [&](Snapshot& s) {
+        s.begin(MMU_SNAPSHOT_MAGIC, snapshot_fingerprint(config));
+        s.put(instruction_counter);
+        s.put(current_process_number);
+        s.put(currentRandomIndex);
+        s.put(totals);
+        s.put_vector(frame_table);
+        s.put_vector(vector<int>(free_frames.begin(), free_frames.end()));
+        s.put((unsigned long long)processes.size());
+        for (const Process& proc : processes) {
+            s.put(proc.page_table);
+            s.put(proc.maps); s.put(proc.unmaps); s.put(proc.ins); s.put(proc.outs); s.put(proc.fins);
+            s.put(proc.fouts); s.put(proc.zeros); s.put(proc.segv); s.put(proc.segprot);
+        }
+        s.put_vector(pager->state());
+        reader.save(s);
+        trace.save(s);
+        wss_tracker.save(s);
+    });
+}
+
+// replaces what setUp() built; trace and WSS outputs are reopened where the snapshot left them
+void restore_checkpoint(const Config& config, Pager* pager, InstructionSource& reader, RunTotals& totals) {
+    Snapshot s;
+    s.read_file(config.restore_file);
+    s.check(MMU_SNAPSHOT_MAGIC, snapshot_fingerprint(config));
+    s.get(instruction_counter);
+    s.get(current_process_number);
+    s.get(currentRandomIndex);
+    s.get(totals);
+    s.get_vector(frame_table);
+    vector<int> free_list;
+    s.get_vector(free_list);
+    free_frames.assign(free_list.begin(), free_list.end());
+    if (s.get<unsigned long long>() != processes.size()) { cerr << "Error: snapshot has a different process count" << endl; exit(1); }
+    for (Process& proc : processes) {
+        s.get(proc.page_table);
+        s.get(proc.maps); s.get(proc.unmaps); s.get(proc.ins); s.get(proc.outs); s.get(proc.fins);
+        s.get(proc.fouts); s.get(proc.zeros); s.get(proc.segv); s.get(proc.segprot);
+    }
+    vector<unsigned long long> pager_state;
+    s.get_vector(pager_state);
+    pager->set_state(pager_state);
+    reader.load(s);
+    trace.resume(config, s);
+    wss_tracker.resume(config, processes.size(), s);
 }
 
 //----------------------------------------------- SIMULATE -------------------------------------------------------
@@ -594,19 +1331,25 @@ void handle_page_fault(Process& proc, int vpage, const Config& config, Pager* pa
         update simulation statistics
         output options
 */
-void simulate(const Config& config, Pager* pager) {
-    unsigned long long cost = 0;  // 64-bit 
-    unsigned long ctx_switches = 0;
-    unsigned long process_exits = 0;
+void simulate(const Config& config, Pager* pager, InstructionSource& reader, RunTotals& totals) {
+    unsigned long long& cost = totals.cost;
+    unsigned long& ctx_switches = totals.ctx_switches;
+    unsigned long& process_exits = totals.process_exits;
+    Snapshot snap;
+    unsigned long long resumed_at = instruction_counter;
     
-    InstructionReader reader(config.input_file);
     char operation;
     int vpage;
     
-    while (reader.get_next_instruction(operation, vpage)) {
+    while (true) {
+        if (config.checkpoint_every && instruction_counter % config.checkpoint_every == 0 && instruction_counter != resumed_at) {
+            save_checkpoint(config, pager, reader, totals, snap);
+        }
+        if (!reader.get_next_instruction(operation, vpage)) break;
         instruction_counter++;
+        if (wss_tracker.enabled) wss_tracker.tick(instruction_counter);
        // cout<< "instr " << instruction_counter<<" : " << operation << " : " << vpage<<endl;
-        if (config.O_option) { printf("%d: ==> %c %d\n", instruction_counter-1, operation, vpage); }
+        trace.instr(instruction_counter-1, operation, vpage);
         
         switch(operation) {
             case 'c': { 
@@ -617,23 +1360,25 @@ void simulate(const Config& config, Pager* pager) {
                 
             case 'e': {  
                 Process& proc = processes[current_process_number];
-                if (config.O_option) {printf("EXIT current process %d\n", current_process_number);}
+                trace.exit_proc(current_process_number);
                 for (int i = 0; i < PTE_ENTRIES; i++) {
                     PTE& pte = proc.page_table[i];
                     if (pte.present) {
-                        if (config.O_option) { printf(" UNMAP %d:%d\n", current_process_number, i); }
+                        trace.unmap(current_process_number, i);
                         proc.unmaps++; cost += COST_UNMAP;
                         if (pte.modified) {
                             const VMA* vma = check_vma_access(proc, i);
                             if (vma && vma->file_mapped) {
-                                if (config.O_option) printf(" FOUT\n");
+                                trace.event(EV_FOUT);
                                 proc.fouts++; cost += COST_FOUT;
                             }
                         }  
+                        if (wss_tracker.enabled) wss_tracker.unmap(current_process_number);
                         return_frame_to_freelist(pte.frame);
                     }
                     pte = PTE(); 
                 }
+                if (wss_tracker.enabled) wss_tracker.exit_proc(current_process_number);
                 process_exits++; cost += COST_PROC_EXIT;
                 break;
             }
@@ -658,9 +1403,10 @@ void simulate(const Config& config, Pager* pager) {
                 }
                 
                 pte.referenced = 1;
+                if (wss_tracker.enabled) wss_tracker.reference(current_process_number, vpage, instruction_counter);
                 if (operation == 'w') {
                     if (pte.write_protect) {
-                        if (config.O_option) printf(" SEGPROT\n");
+                        trace.event(EV_SEGPROT);
                         proc.segprot++;
                         cost += COST_SEGPROT;  
                     } else {
@@ -672,12 +1418,14 @@ void simulate(const Config& config, Pager* pager) {
         }
         
     }
+    trace.close();  // flush before the printf summaries below
+    wss_tracker.close(instruction_counter);
 
     if (config.P_option) { for (const auto& proc : processes) {  print_page_table(proc);  }}
     if (config.F_option) { print_frame_table(); }
     if (config.S_option) {
         for (const auto& proc : processes) {  proc.printProcessSummary(); }
-        printf("TOTALCOST %d %lu %lu %llu %lu\n", 
+        printf("TOTALCOST %llu %lu %lu %llu %lu\n", 
                instruction_counter, ctx_switches, process_exits, cost, sizeof(PTE));
     }
 }
@@ -724,16 +1472,58 @@ void initialize_frame_table(int num_frames) {
     }
 }
 
-void setUp(const Config& config) {
-    parse_input_file(config.input_file);
-    read_random_file(config.rand_file);
+// -E: the generated processes and instructions in the input file format, on stdout
+void emit_workload(const string& spec) {
+    WorkloadGenerator gen(spec);
+    printf("# generated: %s\n%zu\n", spec.c_str(), processes.size());
+    for (const Process& proc : processes) {
+        printf("#### process %d\n#\n%zu\n", proc.pid, proc.vmas.size());
+        for (const VMA& vma : proc.vmas) {
+            printf("%d %d %d %d\n", vma.start_vpage, vma.end_vpage, vma.write_protected ? 1 : 0, vma.file_mapped ? 1 : 0);
+        }
+    }
+    printf("#### instruction simulation ######\n");
+    fflush(stdout);
+
+    BufferedFile out;
+    out.open_fd(STDOUT_FILENO);
+    char operation;
+    int vpage;
+    while (gen.get_next_instruction(operation, vpage)) {
+        out.reserve();
+        out.put_char(operation); out.put_char(' '); out.put_int(vpage); out.put_char('\n');
+    }
+    out.close();
+}
+
+InstructionSource* setUp(const Config& config) {
+    InstructionSource* source;
+    if (!config.workload.empty()) {
+        WorkloadGenerator* gen = new WorkloadGenerator(config.workload);
+        if (config.rand_file.empty()) gen->fill_random_values(randvals, 40000);
+        else read_random_file(config.rand_file);
+        source = gen;
+    } else {
+        parse_input_file(config.input_file);
+        read_random_file(config.rand_file);
+        source = new InstructionReader(config.input_file);
+    }
     initialize_frame_table(config.num_frames);
     // debug_print(config);
+    return source;
 }
 
 int main(int argc, char **argv) {
     Config config = parse_commands(argc, argv);
-    setUp(config);
+    if (!config.decode_file.empty()) {
+        TraceWriter::decode(config.decode_file, config.trace_file);
+        return 0;
+    }
+    if (config.emit) {
+        emit_workload(config.workload);
+        return 0;
+    }
+    InstructionSource* source = setUp(config);
     
     Pager* pager = nullptr;
     switch(config.algo) {
@@ -742,11 +1532,21 @@ int main(int argc, char **argv) {
         case 'c': pager = new Clock(); break;
         case 'e': pager = new NRU(); break;
         case 'a': pager = new Aging(); break;
-        case 'w': pager = new WorkingSet(); break;
+        case 'w': pager = new WorkingSet(config.tau); break;
     }
     
-    simulate(config, pager);
+    RunTotals totals;
+    if (!config.restore_file.empty()) restore_checkpoint(config, pager, *source, totals);
+    else {
+        trace.open(config);
+        wss_tracker.open(config, processes.size());
+    }
+    simulate(config, pager, *source, totals);
+#ifdef MMU_PROFILE
+    pager_profile.write_json(config.profile_file, config.algo, config.num_frames);
+#endif
     
     delete pager;
+    delete source;
     return 0;
 }
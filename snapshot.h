@@ -0,0 +1,170 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+/*
+    Checkpoint files shared by ioschedlab4.cpp and mmu.cpp. A snapshot is a flat byte buffer:
+    an 8-byte magic naming the simulator, a fingerprint of the options the state depends on,
+    then the simulator's fields in a fixed order, written raw (all of them are trivially
+    copyable) and vectors as a length plus their elements. Snapshots are only read back by the
+    same binary on the same machine, so there is no versioning or byte swapping. Input files
+    enter the fingerprint through file_identity(), so a snapshot is not resumed against an input
+    that was edited since.
+
+    write_in_background() forks, and the child serializes its copy-on-write image of the
+    simulator, writes the file (to <path>.tmp, renamed over <path> when complete) and exits.
+    The simulation pauses only for the fork. A crash in the middle of a write leaves the
+    previous snapshot intact.
+*/
+
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+class Snapshot {
+    private:
+        std::vector<char> data;
+        size_t pos = 0;
+        pid_t writer = -1;    // child still writing the previous snapshot
+
+        void need(size_t n) const {
+            if (pos + n > data.size()) { std::cerr << "Error: snapshot is truncated" << std::endl; exit(1); }
+        }
+
+    public:
+        ~Snapshot() { wait_for_writer(); }
+
+        void clear() { data.clear(); pos = 0; }
+
+        template <class T> void put(const T& v) {
+            static_assert(std::is_trivially_copyable<T>::value, "snapshot fields must be trivially copyable");
+            const char* p = reinterpret_cast<const char*>(&v);
+            data.insert(data.end(), p, p + sizeof(T));
+        }
+        template <class T> void put_vector(const std::vector<T>& v) {
+            static_assert(std::is_trivially_copyable<T>::value, "snapshot fields must be trivially copyable");
+            put((unsigned long long)v.size());
+            const char* p = reinterpret_cast<const char*>(v.data());
+            data.insert(data.end(), p, p + v.size() * sizeof(T));
+        }
+        // std::pair is not trivially copyable, so pairs go member by member
+        template <class A, class B> void put_vector(const std::vector<std::pair<A, B> >& v) {
+            put((unsigned long long)v.size());
+            for (const std::pair<A, B>& p : v) { put(p.first); put(p.second); }
+        }
+        void put_string(const std::string& s) { put_vector(std::vector<char>(s.begin(), s.end())); }
+
+        template <class T> void get(T& v) {
+            static_assert(std::is_trivially_copyable<T>::value, "snapshot fields must be trivially copyable");
+            need(sizeof(T));
+            memcpy(&v, data.data() + pos, sizeof(T));
+            pos += sizeof(T);
+        }
+        template <class T> T get() { T v; get(v); return v; }
+        template <class T> void get_vector(std::vector<T>& v) {
+            unsigned long long n = get<unsigned long long>();
+            need(n * sizeof(T));
+            if constexpr (std::is_default_constructible<T>::value) {
+                v.resize(n);
+                if (n) memcpy(v.data(), data.data() + pos, n * sizeof(T));
+                pos += n * sizeof(T);
+            } else {    // copy each element out through aligned storage
+                v.clear();
+                v.reserve(n);
+                alignas(T) unsigned char element[sizeof(T)];
+                for (unsigned long long i = 0; i < n; i++, pos += sizeof(T)) {
+                    memcpy(element, data.data() + pos, sizeof(T));
+                    v.push_back(*reinterpret_cast<const T*>(element));
+                }
+            }
+        }
+        template <class A, class B> void get_vector(std::vector<std::pair<A, B> >& v) {
+            unsigned long long n = get<unsigned long long>();
+            need(n * (sizeof(A) + sizeof(B)));
+            v.resize(n);
+            for (std::pair<A, B>& p : v) { get(p.first); get(p.second); }
+        }
+        std::string get_string() { std::vector<char> v; get_vector(v); return std::string(v.begin(), v.end()); }
+
+        // an input file for the fingerprint: its name, size and modification time
+        static std::string file_identity(const std::string& path) {
+            struct stat st;
+            if (path.empty() || ::stat(path.c_str(), &st) != 0) return path;
+            return path + '@' + std::to_string((long long)st.st_size) + ':' + std::to_string((long long)st.st_mtim.tv_sec) + '.'
+                   + std::to_string((long long)st.st_mtim.tv_nsec);
+        }
+
+        // magic + fingerprint; a snapshot taken with different options must not be resumed
+        void begin(const char magic[8], const std::string& fingerprint) {
+            clear();
+            data.insert(data.end(), magic, magic + 8);
+            put_string(fingerprint);
+        }
+        void check(const char magic[8], const std::string& fingerprint) {
+            need(8);
+            if (memcmp(data.data(), magic, 8) != 0) { std::cerr << "Error: not a snapshot of this simulator" << std::endl; exit(1); }
+            pos = 8;
+            if (get_string() != fingerprint) {
+                std::cerr << "Error: snapshot was taken with different inputs or options" << std::endl; exit(1);
+            }
+        }
+
+        static bool write_file(const std::string& path, const std::vector<char>& bytes) {
+            std::string tmp = path + ".tmp";
+            int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+            if (fd < 0) return false;
+            size_t off = 0;
+            while (off < bytes.size()) {
+                ssize_t n = ::write(fd, bytes.data() + off, bytes.size() - off);
+                if (n <= 0) { ::close(fd); return false; }
+                off += n;
+            }
+            if (::fsync(fd) != 0 || ::close(fd) != 0) return false;
+            return std::rename(tmp.c_str(), path.c_str()) == 0;
+        }
+
+        // fill() appends the simulator's state after begin(); without fork() it runs inline
+        void write_in_background(const std::string& path, const std::function<void(Snapshot&)>& fill) {
+            wait_for_writer();
+            fflush(stdout);
+            pid_t pid = fork();
+            if (pid == 0) {
+                fill(*this);
+                _exit(write_file(path, data) ? 0 : 1);
+            }
+            if (pid < 0) {
+                fill(*this);
+                if (!write_file(path, data)) { std::cerr << "Error: cannot write snapshot " << path << std::endl; }
+            }
+            writer = pid;
+            clear();
+        }
+
+        void wait_for_writer() {
+            if (writer <= 0) return;
+            int status = 0;
+            waitpid(writer, &status, 0);
+            if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) { std::cerr << "Error: writing snapshot failed" << std::endl; }
+            writer = -1;
+        }
+
+        void read_file(const std::string& path) {
+            FILE* f = std::fopen(path.c_str(), "rb");
+            if (f == nullptr) { std::cerr << "Error: cannot open snapshot " << path << std::endl; exit(1); }
+            clear();
+            char buf[1 << 16];
+            size_t n;
+            while ((n = std::fread(buf, 1, sizeof(buf), f)) > 0) data.insert(data.end(), buf, buf + n);
+            std::fclose(f);
+        }
+};
+
+#endif
@@ -0,0 +1,196 @@
+#ifndef WORKLOAD_H
+#define WORKLOAD_H
+
+/*
+    Building blocks for the synthetic workload generators in ioschedlab4.cpp and mmu.cpp.
+    Everything is driven by one seeded xoshiro256** stream, so a spec and a seed always produce
+    the same records, on any machine. Specs are comma-separated key=value lists
+    ("n=1000000,dist=zipf,s=0.9,seed=7").
+*/
+
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+class WorkloadRng {
+    private:
+        uint64_t s[4];
+        static uint64_t rotl(uint64_t x, int k) { return (x << k) | (x >> (64 - k)); }
+
+    public:
+        explicit WorkloadRng(uint64_t seed) {
+            for (int i = 0; i < 4; i++) {   // splitmix64 expands the seed
+                seed += 0x9e3779b97f4a7c15ULL;
+                uint64_t z = seed;
+                z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+                z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+                s[i] = z ^ (z >> 31);
+            }
+        }
+
+        uint64_t next() {
+            uint64_t result = rotl(s[1] * 5, 7) * 9;
+            uint64_t t = s[1] << 17;
+            s[2] ^= s[0]; s[3] ^= s[1]; s[1] ^= s[2]; s[0] ^= s[3];
+            s[2] ^= t;
+            s[3] = rotl(s[3], 45);
+            return result;
+        }
+
+        void get_state(uint64_t out[4]) const { for (int i = 0; i < 4; i++) out[i] = s[i]; }
+        void set_state(const uint64_t in[4]) { for (int i = 0; i < 4; i++) s[i] = in[i]; }
+
+        double uniform() { return (next() >> 11) * (1.0 / 9007199254740992.0); }   // [0, 1)
+        uint64_t below(uint64_t n) { return (uint64_t)(((unsigned __int128)next() * n) >> 64); }
+        bool chance(double p) { return p > 0 && uniform() < p; }
+        double exponential(double mean) { return -mean * std::log1p(-uniform()); }
+};
+
+// Zipf over ranks 1..n with exponent s, O(1) per draw (Hormann and Derflinger's rejection-inversion)
+class ZipfSampler {
+    private:
+        double n, s;
+        double h_integral_x1, h_integral_n, threshold;
+
+        static double helper1(double x) { return std::fabs(x) > 1e-8 ? std::log1p(x) / x : 1 - x * (0.5 - x * (1.0 / 3 - 0.25 * x)); }
+        static double helper2(double x) { return std::fabs(x) > 1e-8 ? std::expm1(x) / x : 1 + x * 0.5 * (1 + x / 3 * (1 + 0.25 * x)); }
+        double h(double x) const { return std::exp(-s * std::log(x)); }
+        double h_integral(double x) const { double lx = std::log(x); return helper2((1 - s) * lx) * lx; }
+        double h_integral_inverse(double x) const {
+            double t = x * (1 - s);
+            if (t < -1) t = -1;
+            return std::exp(helper1(t) * x);
+        }
+
+    public:
+        ZipfSampler(uint64_t n, double s) : n((double)n), s(s) {
+            h_integral_x1 = h_integral(1.5) - 1;
+            h_integral_n = h_integral(this->n + 0.5);
+            threshold = 2 - h_integral_inverse(h_integral(2.5) - h(2));
+        }
+
+        uint64_t sample(WorkloadRng& rng) const {
+            while (true) {
+                double u = h_integral_n + rng.uniform() * (h_integral_x1 - h_integral_n);
+                double x = h_integral_inverse(u);
+                double k = std::floor(x + 0.5);
+                if (k < 1) k = 1;
+                else if (k > n) k = n;
+                if (k - x <= threshold || u >= h_integral(k + 0.5) - h(k)) return (uint64_t)k;
+            }
+        }
+};
+
+/*
+    Picks locations (tracks, pages) in [0, n). uniform: every location alike. zipf: location
+    popularity follows Zipf(s), with hot locations scattered by a seeded permutation instead of
+    all sitting at 0. seq: runs of consecutive locations, a new run starts at a random place
+    with probability 1/run.
+*/
+class LocationSampler {
+    private:
+        enum Kind { UNIFORM, ZIPF, SEQUENTIAL } kind;
+        uint64_t n;
+        ZipfSampler zipf;
+        std::vector<uint64_t> permutation;
+        double jump;
+        uint64_t position = 0;
+
+    public:
+        LocationSampler(const std::string& dist, uint64_t n, double s, double run, WorkloadRng& rng)
+            : kind(UNIFORM), n(n), zipf(n, s), jump(run > 1 ? 1.0 / run : 1.0) {
+            if (dist == "zipf") {
+                kind = ZIPF;
+                permutation.resize(n);
+                for (uint64_t i = 0; i < n; i++) permutation[i] = i;
+                for (uint64_t i = n - 1; i > 0; i--) std::swap(permutation[i], permutation[rng.below(i + 1)]);
+            } else if (dist == "seq") {
+                kind = SEQUENTIAL;
+                position = rng.below(n);
+            } else if (dist != "uniform") {
+                std::cerr << "Unknown distribution '" << dist << "' (uniform, zipf or seq)" << std::endl; exit(1);
+            }
+        }
+
+        uint64_t cursor() const { return position; }    // sequential position, for checkpoints
+        void set_cursor(uint64_t p) { position = p; }
+
+        uint64_t sample(WorkloadRng& rng) {
+            switch (kind) {
+                case ZIPF: return permutation[zipf.sample(rng) - 1];
+                case SEQUENTIAL:
+                    if (rng.chance(jump)) position = rng.below(n);
+                    else position = (position + 1) % n;
+                    return position;
+                default: return rng.below(n);
+            }
+        }
+};
+
+/*
+    Gaps between arrivals. poisson: exponential gaps with the given mean. bursty: bursts of
+    geometric length (mean burst) that arrive on the same tick, separated by exponential idle
+    periods of mean gap * burst, so the long-run rate matches poisson with the same gap.
+*/
+class ArrivalProcess {
+    private:
+        bool bursty;
+        double gap, burst_end;
+        double clock = 0;
+
+    public:
+        ArrivalProcess(const std::string& kind, double gap, double burst) : bursty(kind == "bursty"), gap(gap), burst_end(1.0 / burst) {
+            if (kind != "poisson" && kind != "bursty") {
+                std::cerr << "Unknown arrival process '" << kind << "' (poisson or bursty)" << std::endl; exit(1);
+            }
+        }
+
+        long long next(WorkloadRng& rng) {
+            if (!bursty) clock += rng.exponential(gap);
+            else if (rng.chance(burst_end)) clock += rng.exponential(gap / burst_end);
+            return (long long)clock;
+        }
+};
+
+// key=value,key=value; unknown keys are an error so typos don't silently fall back to defaults
+class WorkloadSpec {
+    private:
+        std::map<std::string, std::string> values;
+        std::map<std::string, bool> used;
+
+        const std::string* find(const std::string& key) {
+            used[key] = true;
+            auto it = values.find(key);
+            return it == values.end() ? nullptr : &it->second;
+        }
+
+    public:
+        explicit WorkloadSpec(const std::string& spec) {
+            std::istringstream iss(spec);
+            std::string item;
+            while (std::getline(iss, item, ',')) {
+                if (item.empty()) continue;
+                size_t eq = item.find('=');
+                if (eq == std::string::npos) { std::cerr << "Bad workload setting '" << item << "' (expected key=value)" << std::endl; exit(1); }
+                values[item.substr(0, eq)] = item.substr(eq + 1);
+            }
+        }
+
+        std::string get(const std::string& key, const std::string& def) { const std::string* v = find(key); return v ? *v : def; }
+        double get(const std::string& key, double def) { const std::string* v = find(key); return v ? std::atof(v->c_str()) : def; }
+        long long get(const std::string& key, long long def) { const std::string* v = find(key); return v ? std::atoll(v->c_str()) : def; }
+
+        // call after every get(); rejects keys nobody asked for
+        void check() const {
+            for (const auto& kv : values) {
+                if (!used.count(kv.first)) { std::cerr << "Unknown workload setting '" << kv.first << "'" << std::endl; exit(1); }
+            }
+        }
+};
+
+#endif